@@ -2,4 +2,4 @@ TEMPLATE = subdirs
 
 # Directories
 
-SUBDIRS = mythpianod theme
+SUBDIRS = mythpianod mythpianorelay theme
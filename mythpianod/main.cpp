@@ -37,6 +37,7 @@ THE SOFTWARE.
 
 // MythPianod headers
 #include "mythpianod.h"
+#include "mythpianocoverart.h"
 
 using namespace std;
 
@@ -64,6 +65,7 @@ void setupKeys(void)
   REG_KEY("MythPianod", "PLAY",        "Play",        "p");
   REG_KEY("MythPianod", "PAUSE",       "Pause",        " ");
   REG_KEY("MythPianod", "NEXTTRACK",   "Move to the next track", ",,<,Q,Home");
+  REG_KEY("MythPianod", "STATS",       "Write pianod statistics to a file", "Ctrl+S");
 }
 
 int mythplugin_init(const char *libversion)
@@ -73,6 +75,7 @@ int mythplugin_init(const char *libversion)
 				  MYTH_BINARY_VERSION))
     return -1;
   setupKeys();
+  GetMythPianoCoverArtCache()->Load();
   return 0;
 }
 
@@ -157,6 +160,20 @@ int showStationSelectDialog()
   return 0;
 }
 
+int showZoneSelectDialog()
+{
+  MythScreenStack *mainStack = GetMythMainWindow()->GetMainStack();
+  MythPianodZoneSelect *select = new MythPianodZoneSelect(mainStack, "pandorazones");
+  if (select->Create()) {
+    mainStack->AddScreen(select);
+    return 0;
+  } else {
+    delete select;
+    return -1;
+  }
+  return 0;
+}
+
 int showPlayerDialog()
 {
   MythScreenStack *mainStack = GetMythMainWindow()->GetMainStack();
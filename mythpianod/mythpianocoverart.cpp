@@ -0,0 +1,377 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <utime.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QUrl>
+#include <QMetaObject>
+
+// MythTV headers
+#include "mythcontext.h"
+#include "mythdirs.h"
+
+// MythPianod headers
+#include "mythpianocoverart.h"
+
+static MythPianoCoverArtCache *gMythPianoCoverArtCache = NULL;
+MythPianoCoverArtCache *GetMythPianoCoverArtCache()
+{
+  if (!gMythPianoCoverArtCache)
+    gMythPianoCoverArtCache = new MythPianoCoverArtCache();
+
+  return gMythPianoCoverArtCache;
+}
+
+MythPianoCoverArtCache::MythPianoCoverArtCache()
+  : m_Dir(GetConfDir() + "/MythPianod/coverart"),
+    m_Bytes(0),
+    m_Limit((qint64) gCoreContext->GetNumSetting("pandora-coverart-cache-mb", 64) << 20)
+{
+}
+
+/* Build the in-memory index from what earlier runs left on disk. */
+void MythPianoCoverArtCache::Load()
+{
+  QDir dir(m_Dir);
+
+  m_Index.clear();
+  m_Bytes = 0;
+
+  if (!dir.mkpath(m_Dir)) {
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot create " + m_Dir);
+    return;
+  }
+
+  QFileInfoList files = dir.entryInfoList(QDir::Files);
+  for (int x = 0; x < files.size(); x++) {
+    const QFileInfo &fi = files.at(x);
+    Entry entry;
+
+    if (fi.fileName().endsWith(".tmp")) {
+      QFile::remove(fi.filePath());
+      continue;
+    }
+
+    entry.size = fi.size();
+    entry.used = fi.lastModified().toTime_t();
+    m_Index.insert(fi.fileName(), entry);
+    m_Bytes += entry.size;
+  }
+
+  LOG(VB_GENERAL, LOG_INFO, QString("MythPianod: %1 cached cover art files, %2 KB")
+      .arg(m_Index.size()).arg(m_Bytes >> 10));
+
+  Evict(QString());
+}
+
+QString MythPianoCoverArtCache::Key(const QString &url) const
+{
+  return QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+QString MythPianoCoverArtCache::Path(const QString &key) const
+{
+  return m_Dir + "/" + key;
+}
+
+/* Returns the cached file for url, or an empty string on a miss. */
+QString MythPianoCoverArtCache::Lookup(const QString &url)
+{
+  QString key = Key(url);
+  QHash<QString, Entry>::iterator it = m_Index.find(key);
+
+  if (it == m_Index.end())
+    return QString();
+
+  /* the file's mtime carries the LRU order over to the next run */
+  QString path = Path(key);
+  it->used = QDateTime::currentDateTime().toTime_t();
+  utime(path.toLocal8Bit().data(), NULL);
+  return path;
+}
+
+/* Save data as the art for url. Returns the file, or "" on failure. */
+QString MythPianoCoverArtCache::Store(const QString &url, const QByteArray &data)
+{
+  QString key = Key(url);
+  QString path = Path(key);
+  QFile file(path + ".tmp");
+
+  if (data.isEmpty())
+    return QString();
+
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      file.write(data) != data.size()) {
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot write " + file.fileName());
+    file.remove();
+    return QString();
+  }
+  file.close();
+
+  QFile::remove(path);
+  if (!QFile::rename(path + ".tmp", path)) {
+    QFile::remove(path + ".tmp");
+    return QString();
+  }
+
+  if (m_Index.contains(key))
+    m_Bytes -= m_Index[key].size;
+
+  Entry entry;
+  entry.size = data.size();
+  entry.used = QDateTime::currentDateTime().toTime_t();
+  m_Index.insert(key, entry);
+  m_Bytes += entry.size;
+
+  Evict(key);
+  return path;
+}
+
+/* Forget url's art, say because what was saved for it turned out not to decode. */
+void MythPianoCoverArtCache::Remove(const QString &url)
+{
+  QString key = Key(url);
+  QHash<QString, Entry>::iterator it = m_Index.find(key);
+
+  if (it == m_Index.end())
+    return;
+
+  QFile::remove(Path(key));
+  m_Bytes -= it->size;
+  m_Index.erase(it);
+}
+
+/* Drop least recently used files until we are under the cap. */
+void MythPianoCoverArtCache::Evict(const QString &keep)
+{
+  while (m_Bytes > m_Limit && m_Index.size() > 1) {
+    QHash<QString, Entry>::iterator it, oldest = m_Index.end();
+
+    for (it = m_Index.begin(); it != m_Index.end(); ++it) {
+      if (it.key() == keep)
+        continue;
+      if (oldest == m_Index.end() || it->used < oldest->used)
+        oldest = it;
+    }
+
+    if (oldest == m_Index.end())
+      break;
+
+    QFile::remove(Path(oldest.key()));
+    m_Bytes -= oldest->size;
+    m_Index.erase(oldest);
+  }
+}
+
+/* decoded pictures kept in memory: the current one plus the prefetched */
+static int max_images = 8;
+/* decode threads; one for the current track, one for prefetching */
+static int max_decoders = 2;
+
+MythPianoCoverArtLoader::MythPianoCoverArtLoader(QObject *parent)
+  : QObject(parent),
+    m_Http(NULL)
+{
+  m_Pool.setMaxThreadCount(max_decoders);
+}
+
+MythPianoCoverArtLoader::~MythPianoCoverArtLoader()
+{
+  if (m_Http) {
+    m_Http->disconnect(this);
+    m_Http->abort();
+    delete m_Http;
+  }
+
+  // finished jobs post to us; make sure none are still running
+  m_Pool.waitForDone();
+}
+
+/* The decoded art for url, if it is ready. */
+bool MythPianoCoverArtLoader::Get(const QString &url, QImage &image)
+{
+  if (!m_Images.contains(url))
+    return false;
+
+  image = m_Images.value(url);
+  m_Used.removeAll(url);
+  m_Used.append(url);
+  return true;
+}
+
+/* Art for the track that is playing now: jump the queue. Ready() follows. */
+void MythPianoCoverArtLoader::Request(const QString &url)
+{
+  if (url.isEmpty())
+    return;
+
+  if (m_Images.contains(url)) {
+    emit Ready(url);
+    return;
+  }
+
+  // already downloading or on its way through the pool, Ready() comes from decoded()
+  if (url == m_Fetching || m_Decoding.contains(url) || DecodeCached(url))
+    return;
+
+  m_Wanted.removeAll(url);
+  m_Wanted.prepend(url);
+  Next();
+}
+
+/* Art for a track further down the queue: fetch it when there is time. */
+void MythPianoCoverArtLoader::Prefetch(const QString &url)
+{
+  if (url.isEmpty() || m_Images.contains(url) || m_Decoding.contains(url) ||
+      m_Wanted.contains(url) || url == m_Fetching)
+    return;
+
+  if (DecodeCached(url))
+    return;
+
+  m_Wanted.append(url);
+  Next();
+}
+
+/* One download at a time, in the order of m_Wanted. */
+void MythPianoCoverArtLoader::Next()
+{
+  if (m_Http || m_Wanted.isEmpty())
+    return;
+
+  m_Fetching = m_Wanted.takeFirst();
+
+  QUrl u(m_Fetching);
+  m_Http = new QHttp(this);
+  connect(m_Http, SIGNAL(done(bool)), this, SLOT(fetched(bool)));
+  m_Http->setHost(u.host(), QHttp::ConnectionModeHttp, u.port(80));
+  m_Http->get(QUrl::toPercentEncoding(u.path(), "!$&'()*+,;=:@/"));
+}
+
+void MythPianoCoverArtLoader::fetched(bool error)
+{
+  QString url = m_Fetching;
+  QByteArray data;
+  /* done() is not an error for a 404 or a 503; their pages are not art */
+  int status = error ? 0 : m_Http->lastResponse().statusCode();
+
+  if (error)
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cover art download failed: " +
+        m_Http->errorString());
+  else if (status != 200)
+    LOG(VB_GENERAL, LOG_ERR, QString("MythPianod: cover art download failed: "
+                                     "HTTP %1 for %2").arg(status).arg(url));
+  else
+    data = m_Http->readAll();
+
+  m_Http->deleteLater();
+  m_Http = NULL;
+  m_Fetching.clear();
+
+  if (status == 200) {
+    GetMythPianoCoverArtCache()->Store(url, data);
+    Decode(url, data);
+  }
+
+  Next();
+}
+
+/* Cache hit: let the pool read the file as well as decode it. */
+bool MythPianoCoverArtLoader::DecodeCached(const QString &url)
+{
+  QString path = GetMythPianoCoverArtCache()->Lookup(url);
+
+  if (path.isEmpty())
+    return false;
+
+  m_Decoding.insert(url);
+  m_Pool.start(new MythPianoCoverArtDecoder(this, url, QByteArray(), path, m_Size));
+  return true;
+}
+
+void MythPianoCoverArtLoader::Decode(const QString &url, const QByteArray &data)
+{
+  m_Decoding.insert(url);
+  m_Pool.start(new MythPianoCoverArtDecoder(this, url, data, QString(), m_Size));
+}
+
+/* Back on the GUI thread with a widget-sized image, or a null one. */
+void MythPianoCoverArtLoader::decoded(QString url, QImage image)
+{
+  m_Decoding.remove(url);
+
+  /* whether read from the cache or just stored there, don't serve it again */
+  if (image.isNull()) {
+    GetMythPianoCoverArtCache()->Remove(url);
+    return;
+  }
+
+  m_Images.insert(url, image);
+  m_Used.removeAll(url);
+  m_Used.append(url);
+
+  while (m_Used.size() > max_images)
+    m_Images.remove(m_Used.takeFirst());
+
+  emit Ready(url);
+}
+
+MythPianoCoverArtDecoder::MythPianoCoverArtDecoder(QObject *loader,
+						   const QString &url,
+						   const QByteArray &data,
+						   const QString &path,
+						   const QSize &size)
+  : m_Loader(loader),
+    m_Url(url),
+    m_Data(data),
+    m_Path(path),
+    m_Size(size)
+{
+}
+
+/* Decode and scale to the widget once, so showing it is just a blit. */
+void MythPianoCoverArtDecoder::run()
+{
+  QImage image;
+
+  if (!m_Path.isEmpty()) {
+    QFile file(m_Path);
+    if (file.open(QIODevice::ReadOnly))
+      m_Data = file.readAll();
+  }
+
+  if (!image.loadFromData(m_Data))
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot decode cover art " + m_Url);
+  else if (m_Size.isValid() && !m_Size.isEmpty())
+    image = image.scaled(m_Size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+  QMetaObject::invokeMethod(m_Loader, "decoded", Qt::QueuedConnection,
+			    Q_ARG(QString, m_Url), Q_ARG(QImage, image));
+}
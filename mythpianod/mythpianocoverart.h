@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOCOVERART_H
+#define MYTHPIANOCOVERART_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QHttp>
+#include <QImage>
+#include <QSize>
+#include <QSet>
+#include <QRunnable>
+#include <QThreadPool>
+
+/*
+ * Cover art kept on disk under the MythTV config dir, one file per art
+ * URL named after the URL's hash. The index of what is there is read
+ * once when the plugin starts; after that a lookup never touches the
+ * disk. When the cache grows past its size cap, the least recently
+ * shown pictures are thrown out first. Use from the GUI thread only.
+ */
+class MythPianoCoverArtCache
+{
+ public:
+  MythPianoCoverArtCache();
+
+  void    Load();
+  QString Lookup(const QString &url);
+  QString Store(const QString &url, const QByteArray &data);
+  void    Remove(const QString &url);
+
+ private:
+  struct Entry {
+    qint64 size;
+    uint   used;
+  };
+
+  QString Key(const QString &url) const;
+  QString Path(const QString &key) const;
+  void    Evict(const QString &keep);
+
+  QString               m_Dir;
+  QHash<QString, Entry> m_Index;
+  qint64                m_Bytes;
+  qint64                m_Limit;
+};
+
+MythPianoCoverArtCache *GetMythPianoCoverArtCache();
+
+/*
+ * Gets cover art ready for display: downloaded (or read from the cache
+ * above), decoded and scaled to the size of the coverart widget. The
+ * current track's art is fetched first; art for the tracks queued after
+ * it is prefetched behind that, so that by the time a song starts its
+ * picture is normally already sitting in memory.
+ *
+ * Downloads are asynchronous QHttp requests; decoding and scaling run on
+ * a small private thread pool, so the GUI thread only ever touches
+ * finished, widget-sized images.
+ */
+class MythPianoCoverArtLoader : public QObject
+{
+  Q_OBJECT
+
+ public:
+  MythPianoCoverArtLoader(QObject *parent = NULL);
+  ~MythPianoCoverArtLoader();
+
+  void SetSize(const QSize &size) { m_Size = size; }
+  bool Get(const QString &url, QImage &image);
+  void Request(const QString &url);
+  void Prefetch(const QString &url);
+
+ signals:
+  void Ready(QString url);
+
+ private slots:
+  void fetched(bool error);
+  void decoded(QString url, QImage image);
+
+ private:
+  void Next();
+  void Decode(const QString &url, const QByteArray &data);
+  bool DecodeCached(const QString &url);
+
+  QSize                  m_Size;
+  QHttp                 *m_Http;
+  QString                m_Fetching;
+  QStringList            m_Wanted;
+  QSet<QString>          m_Decoding;
+  QHash<QString, QImage> m_Images;
+  QStringList            m_Used;
+  QThreadPool            m_Pool;
+};
+
+/*
+ * One decode job for the loader's pool: turns the encoded bytes (or the
+ * cache file holding them) into an image of at most the widget size and
+ * posts it back to the loader's decoded() slot.
+ */
+class MythPianoCoverArtDecoder : public QRunnable
+{
+ public:
+  MythPianoCoverArtDecoder(QObject *loader, const QString &url,
+			   const QByteArray &data, const QString &path,
+			   const QSize &size);
+
+  void run();
+
+ private:
+  QObject    *m_Loader;
+  QString     m_Url;
+  QByteArray  m_Data;
+  QString     m_Path;
+  QSize       m_Size;
+};
+
+#endif /* MYTHPIANOCOVERART_H */
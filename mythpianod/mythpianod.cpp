@@ -27,6 +27,9 @@ THE SOFTWARE.
 #include <assert.h>
 
 #include <QUrl>
+#include <QCoreApplication>
+#include <QSet>
+#include <QDir>
 
 // MythTV headers
 #include "mythuibutton.h"
@@ -38,40 +41,91 @@ THE SOFTWARE.
 
 // MythPianod headers
 #include "mythpianod.h"
+#include "mythpianocoverart.h"
+#include "mythpianostats.h"
 
 static int debug = 0;
 
+
 MythPianoService::MythPianoService()
   : m_PlayerThread(NULL),
+    m_Worker(NULL),
+    active_zone(0),
     m_Listener(NULL),
-    m_Timer(NULL),
     current_station(-1),
     current_station_name(""),
-    pianod_ip("127.0.0.1"),
-    pianod_port(4445),
-    pianod_fd(-1),
-    response(NULL),
+    connected(0),
     duration("00:00"),
     played("00:00"),
-    song_changed(0)
+    song_changed(0),
+    play_state(0),
+    played_secs(-1),
+    intertrack_started(0),
+    last_gap_ms(-1),
+    volume_level(100),
+    volume_sent(-1),
+    volume_unmute(-1),
+    volume_busy(0),
+    volume_set(0)
+{
+  qRegisterMetaType<MythPianoSong>("MythPianoSong");
+  qRegisterMetaType<MythPianoStringList>("MythPianoStringList");
+  qRegisterMetaType<MythPianoPlaylist>("MythPianoPlaylist");
+
+  /* a burst of ratings settles before any of it goes out */
+  m_RatingTimer = new QTimer(this);
+  m_RatingTimer->setSingleShot(true);
+  m_RatingTimer->setInterval(500);
+  connect(m_RatingTimer, SIGNAL(timeout()), this, SLOT(flush_ratings()));
+
+  /* a held volume key sends at most one command per frame, and one at a time */
+  m_VolumeTimer = new QTimer(this);
+  m_VolumeTimer->setSingleShot(true);
+  m_VolumeTimer->setInterval(40);
+  connect(m_VolumeTimer, SIGNAL(timeout()), this, SLOT(flush_volume()));
+
+  /* statistics go to the log every so often, if anyone asked for them */
+  int stats_interval = gCoreContext->GetNumSetting("pandora-stats-interval", 0);
+  m_StatsTimer = new QTimer(this);
+  connect(m_StatsTimer, SIGNAL(timeout()), this, SLOT(log_stats()));
+  if(stats_interval > 0)
+	m_StatsTimer->start(stats_interval * 1000);
+}
+
+void MythPianoService::log_stats()
 {
+  QStringList report = GetMythPianoStats()->Report();
+
+  for(int x = 0; x < report.size(); x++)
+	LOG(VB_GENERAL, LOG_INFO, "MythPianod: " + report[x]);
+}
+
+/* On demand, for when the log is too far away: ~/.mythtv/MythPianod/stats.txt */
+void MythPianoService::DumpStats()
+{
+  QString dir = GetConfDir() + "/MythPianod";
+  QString path = dir + "/stats.txt";
+
+  QDir().mkpath(dir);
+  if(GetMythPianoStats()->Dump(path))
+	BroadcastMessage("Statistics written to %s\n", path.toUtf8().data());
+  else
+	BroadcastMessage("Could not write %s\n", path.toUtf8().data());
 }
 
 void MythPianoService::SetCurrentStation(QString name) {
-  int x = 0;
+  int x = stations.Find(name);
 
-  for(x = 0; x < stations.size(); x++) { 
-	if(QString(stations[x].c_str()) == name) {
-		current_station_name = stations[x];
-		current_station = x;
-		break;
-	}
+  if(x != -1) {
+	current_station_name = stations.Name(x);
+	current_station = x;
   }
 }
 MythPianoService::~MythPianoService()
 {
-    if(pianod_fd != -1)
+    if(connected)
       Logout();
+    StopPlayerThread();
 }
 
 void
@@ -113,287 +167,172 @@ void MythPianoService::Logout()
 {
   rlen = sprintf(request, "stop now\n");
   SendPianodRequest(200);
-  PianodDisconnect("Exiting plugin from Pianod");
+  StopPlayerThread();
   if(debug)
   printf("Exiting plugin from Pianod\n");
 }
 
-void MythPianoService::PianodDisconnect(string msg) {
-	std::cout<<msg<<endl;
-	close(pianod_fd);
-	pianod_fd = -1;
-	if(response) {
-		delete(response);
-		response = NULL;
-	}
-}
-
-void MythPianoService::CheckForResponse(int success1, int success2, int success3, int success4, int len) {
-	if(response) {
-		delete(response);
-		response = NULL;
-	}
-	if(len > 0) {
-		response = GetPianodLines(success1, success2, success3, success4);
-	} else {
-		perror("Failed to send pianod request");
-	}
-}
-
-int MythPianoService::SendPianodRequest(int success) {
-	int len = write(pianod_fd, request, rlen);
- 	CheckForResponse(success, -1, -1, -1, len);
-	return len;
-}
-
-static int max_response = 4000;
-
-std::vector<MythPianoResponse> * MythPianoService::GetPianodLines(int success1, int success2, int success3, int success4)
-{
-	int total = 0;
-	char byte;
-	string line = "";
-	std::vector<MythPianoResponse> * resp = new std::vector<MythPianoResponse>();
-
-	if(pianod_fd == -1) {
-		if(debug)
-		printf("socket is closed. ignoring request.\n");
-		return resp;
-	}
-
-	while(total++ < max_response) {
-		int len = read(pianod_fd, &byte, 1);
-		if(len < 0) {
-			PianodDisconnect("Error getting response from pianod\n");
-			perror("read");
-			return resp;
-		}
+/*
+ * Hand the command(s) in 'request' to the I/O thread. Never blocks: the
+ * reply, if anyone cares about it, comes back through the session's
+ * signals. Returns -1 if there is no I/O thread to take it.
+ *
+ * 'request' may hold several newline-terminated commands. They are sent
+ * to pianod in a single write and each gets its own reply; all but the
+ * last are expected to end in 200, and 'success', 'kind' and 'failure'
+ * describe the last one.
+ */
+int MythPianoService::SendPianodRequest(int success, int kind, const char *failure) {
+	int start = 0;
 
+	if(!m_Worker)
+		return -1;
 
-		if(byte == '\n') {
-			int code = atoi(line.substr(0,3).c_str());
-			string value = line.substr(4);
-			int stop = 0;
-
-			if(code == 101) {
-				if(success1 != 101 && (success2 != -1 && success2 != 101) && (success3 != -1 && success3 != 101)&& (success4 != -1 && success4 != 101)) {
-					line = "";
-					if(debug)
-					printf("Ignoring current track\n");
-					continue;		
-				}
-			} else if(code == 102) {
-				if(success1 != 102 && (success2 != -1 && success2 != 102) && (success3 != -1 && success3 != 102)&& (success4 != -1 && success4 != 102)) {
-					line = "";
-					if(debug)
-					printf("Ignoring current track\n");
-					continue;
-				}
-			} else if(code == 100) {
-				line = "";
-				if(debug)
-				printf("Ignoring welcome.\n");
-				continue;
-			} else if(code == 203) {
-				if(debug)
-				std::cout<<"Status code: " << code << " value: " << value << endl;
-			} else if(code > 100 && code < 200) {
-				if(debug)
-				std::cout<<"Info code: " << code << " value: " << value << endl;
-			} else if(code >= 200 && code <= 299) {
-				if(debug)
-				std::cout<<"Success code: " << code << " value: " << value << endl;
-			} else if(code >= 400 && code <= 499) {
-				std::cout<<"Error code: " << code << " value: " << value << endl;
-				stop = 1;
-			} else {
-				std::cout<<"Unknown error: " << code << " value: " << value << endl;
-			}
-			line = "";
-			resp->push_back(MythPianoResponse(code, value));
-			if(stop || (success1 == code) || (success2 != -1 && success2 == code) || (success3 != -1 && success3 == code)|| (success4 != -1 && success4 == code))
-				break;
-			if(debug)
-			printf("Not stopping: %d != %d\n", code, success1);	
-					
-		} else {
-			line += byte;
+	while(start < rlen) {
+		const char *eol = (const char *) memchr(request + start, '\n', rlen - start);
+		int end = eol ? eol - request + 1 : rlen;
+		int last = (end == rlen);
+		MythPianoCommand cmd(last ? kind : MythPianoCommand::Plain,
+				     last ? success : 200,
+				     string(request + start, end - start),
+				     last && failure ? failure : "");
+		cmd.zone = active_zone;
+
+		if(!m_Worker->Post(cmd, last)) {
+			m_Worker->Wake();
+			BroadcastMessage("pianod is not keeping up, dropped request\n");
+			return -1;
 		}
+		start = end;
 	}
-
-	if(total >= max_response) {
-		resp->push_back(MythPianoResponse(400, "Response was too big\n"));
-		PianodDisconnect("Response is too big. Assuming Error\n");
-		return resp;
-	}	
-
-	return resp;
-}
-
-int MythPianoService::RepopulateStations() {
-  BroadcastMessage("Retrieving station list...\n");
-  stations.clear();
-  rlen = sprintf(request, "stations list\n");
-  SendPianodRequest(204);
-  if(response->back().code == 204) {
-	  for(int x = 0; x < response->size(); x++) {
-	     MythPianoResponse r = response->at(x);
-	     if(r.code != 115)
-		continue;
-	     /* remove the "Station: " */
-	     r.value = r.value.substr(9);
-	     std::cout<<"Adding station: " << r.value << endl;
-	     stations.push_back(r.value);
-	  }
-  } else {
-     PianodDisconnect("Failed to retrieve station list. Bailing: " + response->back().value);
-     return -1;
-  }
-  service_heartbeat();
-  return 0;
+	return rlen;
 }
 
 int MythPianoService::Login()
 {
   QString username = gCoreContext->GetSetting("pandora-username");
   QString password = gCoreContext->GetSetting("pandora-password");
-
-  //wtf really?
-  char* usernameBuff = strndup(username.toUtf8().data(), 1024);
-  char* passwordBuff = strndup(password.toUtf8().data(), 1024);
-
-  if(pianod_fd != -1) {
-	if(debug)
-	printf("Already connected.\n");
-	if(RepopulateStations() < 0)
-		return -1;
-	return 0;
-  }
-
-  int fd = -1;
-
-  if((fd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
-	perror("could not open pianod socket");
-  	return -1;
-  }
-
-  bzero(&pianod_addr, sizeof(pianod_addr));
-  pianod_addr.sin_family = AF_INET;
-  pianod_addr.sin_addr.s_addr = inet_addr(pianod_ip);
-  pianod_addr.sin_port = htons(pianod_port);
-
-  if(::connect(fd, (struct sockaddr *) &pianod_addr, sizeof(struct sockaddr_in)) < 0) { 
- 	perror("could not connect to pianod server");
+  QString host = gCoreContext->GetSetting("pandora-host", "127.0.0.1");
+  int port = gCoreContext->GetNumSetting("pandora-port", 4445);
+  /* however slow pianod is, the frontend gets its screen back after this;
+     by default a dial's worth of time and a little for the credentials */
+  unsigned long login_timeout = gCoreContext->GetNumSetting("pandora-login-timeout", 15) * 1000;
+
+  StartPlayerThread();
+
+  /* the main zone is whatever the settings screen says */
+  zones[0]->SetServer(host, port);
+
+  MythPianoZone *zone = zones[active_zone];
+  MythPianoSession *session = m_Worker->Session(active_zone);
+  session->SetServer(zone->Host().toUtf8().data(), zone->Port());
+
+  /* show the stations we saw last time; pianod's list replaces them when it is in */
+  stations.SetKey(zone->Host() + ":" + QString::number(zone->Port()), username);
+  ratings.SetKey(zone->Host() + ":" + QString::number(zone->Port()), username);
+  stations.Load();
+  current_station = -1;
+  if(current_station_name.size())
+	SetCurrentStation(QString(current_station_name.c_str()));
+
+  rlen = snprintf(request, sizeof(request), "user %s %s\n",
+		  username.toUtf8().data(), password.toUtf8().data());
+  if(rlen >= (int) sizeof(request))
 	return -1;
-  }
-
-  BroadcastMessage("Connecting to pianod...\n");
-  pianod_fd = fd;
-  response = GetPianodLines(200, -1, -1, -1);
-  int responses = response->size();
+  string auth(request, rlen);
 
-  if(responses != 1) {
-	printf("More than one pianod response: %d\n", responses);
-	PianodDisconnect("too many initial pianod responses");
+  session->BeginLogin();
+  if(SendPianodRequest(200, MythPianoCommand::Login) < 0)
 	return -1;
-  }
 
-  if((*response)[0].code != 200) {
-	PianodDisconnect("Non-successful attempt on initial connection: " + (*response)[0].code + (*response)[0].value);
+  if(session->WaitForLogin(login_timeout) < 0) {
+	/* pick up the reason it failed */
+	QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
 	return -1;
   }
 
-  BroadcastMessage("Authenticating with pianod...\n");
-  rlen = sprintf(request, "user %s %s\n", usernameBuff, passwordBuff); 
-  SendPianodRequest(200);
-
-  if(response->back().code != 200) {
-	PianodDisconnect("Authentication failed: " + response->back().value);
-	return -1;
-  }
+  /* station list and messages were queued for us before the wakeup */
+  QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+  connected = 1;
+  ConnectZones(auth);
+  flush_ratings();
+  return 0;
+}
 
-  BroadcastMessage("Connected to pianod.\n");
+/*
+ * Bring up the zones we are not looking at, without waiting for them,
+ * so the zone picker can show what they are playing. From then on they
+ * tell us themselves; nothing polls them.
+ */
+void MythPianoService::ConnectZones(const string &auth)
+{
+  for(int x = 0; x < (int) zones.size(); x++) {
+	if(x == active_zone || zones[x]->Connected())
+		continue;
 
-  // wtf
-  free(usernameBuff);
-  free(passwordBuff);
+	m_Worker->Session(x)->SetServer(zones[x]->Host().toUtf8().data(), zones[x]->Port());
 
-  if(RepopulateStations() < 0) {
-	return -1;
+	MythPianoCommand login(MythPianoCommand::Login, 200, auth);
+	MythPianoCommand status(MythPianoCommand::Status, 204, "status\n");
+	login.zone = status.zone = x;
+	m_Worker->Post(login, 0);
+	m_Worker->Post(status, 0);
   }
-
-  return 0;
+  m_Worker->Wake();
 }
 
-map<string, string> MythPianoService::PullOutSong(int idx) 
+/*
+ * Point the player at another zone. Everything we knew belongs to the
+ * old one, so start from scratch; the caller logs in to pick it all up.
+ */
+void MythPianoService::SelectZone(int zone)
 {
-	map<string, string> song;
+  if(zone == active_zone || zone < 0 || zone >= (int) zones.size())
+	return;
 
-	  for(idx; idx < response->size(); idx++) {
-	     MythPianoResponse r = response->at(idx);
-	     if(r.code == 204 or r.code == 203) {
-	              break;
-	     } else {
-		     /* remove the "Station: " */
-		     size_t pos = r.value.find(": ");
-		     string key = r.value.substr(0, pos);
-		     string value = r.value.substr(pos + 2); 
-		     if(debug)
-		     std::cout<<"Song: " + key + " = " + value << endl;
-		     song[key] = value;
-	     }
-	  }
-	return song;
+  active_zone = zone;
+  connected = zones[zone]->Connected();
+  /* whatever the old zone had not answered waits for us to come back */
+  ratings.Requeue();
+  /* and its answer to a volume command would be dropped on the way in */
+  volume_busy = 0;
+  volume_sent = -1;
+
+  current_song.Clear();
+  song_changed = MythPianoSong::AllFields;
+  playlist.clear();
+  stations.Clear();
+  current_station = -1;
+  current_station_name = "";
+  play_state = 0;
+  played_secs = -1;
+  played = duration = "00:00";
+}
+
+/* Only the zone on screen gets to change the service's idea of things. */
+bool MythPianoService::FromActiveZone()
+{
+  return m_Worker && sender() == m_Worker->Session(active_zone);
 }
 
 int MythPianoService::GetPlaylist()
 {
-  BroadcastMessage("Getting playlist...\n");
   rlen = sprintf(request, "queue\n");
-  SendPianodRequest(204);
-
-  /* parse play list from queue command */
-  if(response->back().code == 204) {
-	  playlist.clear();
-	  for(int x = 0; x < response->size() - 1; x++) {
-	     MythPianoResponse r = response->at(x);
-	     if(response->at(x).code == 203) {
-		  map<string, string> song = PullOutSong(x + 1);
- 		  if(song.size() != 0) {
-		      cout<<"Storing new song: " << song["Title"] << endl;
-		      playlist.push_back(song);
-		  }
-	     }
-	  }
-  } else {
-	BroadcastMessage("Failed to get playlist(2)!\n");
-        return -1;
-  }
-
-  if(service_heartbeat() < 0) {
-	BroadcastMessage("service heartbeat failed\n");
+  if(SendPianodRequest(204, MythPianoCommand::Queue, "Failed to get playlist(2)!\n") < 0)
 	return -1;
-  }
- 
+
   return 0;
-  
 }
 
 void MythPianoService::StartPlayback()
 {
   BroadcastMessage("Starting playback... \n");
   
-  rlen = sprintf(request, "stop now\n");
-  SendPianodRequest(200);
-  rlen = sprintf(request, "select station \"%s\"\n", stations[current_station].c_str());
-  SendPianodRequest(200);
-  rlen = sprintf(request, "play\n");
-  SendPianodRequest(200);
-  if(response->back().code != 200) {
-	BroadcastMessage("Failed to start playback!\n");
+  rlen = snprintf(request, sizeof(request), "stop now\nselect station \"%s\"\nplay\n",
+		  stations.Name(current_station).c_str());
+  if(rlen >= (int) sizeof(request))
 	return;
-  }
-
+  SendPianodRequest(200, MythPianoCommand::Plain, "Failed to start playback!\n");
 
   if (playlist.size() == 0) {
     BroadcastMessage("Empty playlist");
@@ -401,24 +340,102 @@ void MythPianoService::StartPlayback()
   }
 }
 
+/*
+ * Bring up the pianod I/O thread if it is not running yet. Everything
+ * that touches the socket happens over there; we only post commands to
+ * it and get the results back as queued signals.
+ */
 void MythPianoService::StartPlayerThread() {
-  if (m_Timer) {
-    m_Timer->stop();
-    m_Timer->disconnect();
-    delete m_Timer;
+  if (m_PlayerThread) {
+    if (connected)
+      RequestStatus();
+    return;
   }
-  m_Timer = new QTimer(this);
-  connect(m_Timer, SIGNAL(timeout()), this, SLOT(service_heartbeat()));
-  m_Timer->start(1000);
+
+  zones = LoadMythPianoZones(this);
+  if(active_zone >= (int) zones.size())
+	active_zone = 0;
+
+  m_PlayerThread = new QThread(this);
+  m_Worker = new MythPianoWorker(zones.size());
+  m_Worker->moveToThread(m_PlayerThread);
+
+  connect(m_PlayerThread, SIGNAL(started()), m_Worker, SLOT(Start()));
+
+  for(int x = 0; x < (int) zones.size(); x++) {
+	MythPianoSession *session = m_Worker->Session(x);
+	MythPianoZone *zone = zones[x];
+
+	session->SetSpare(gCoreContext->GetNumSetting("pandora-spare-connection", 0));
+	/* how long pianod gets to pick up and to answer; all zones wait on the one thread */
+	session->SetTimeouts(gCoreContext->GetNumSetting("pandora-connect-timeout", 10) * 1000,
+			     gCoreContext->GetNumSetting("pandora-connect-stagger", 250),
+			     gCoreContext->GetNumSetting("pandora-reply-timeout", 20) * 1000);
+	/* byte-for-byte recording of the session, for mythpianofake -r to play back */
+	QString trace = gCoreContext->GetSetting("pandora-trace");
+	if(!trace.isEmpty())
+		session->SetTrace((x ? trace + QString(".%1").arg(x) : trace).toUtf8().data());
+	/* a local mythpianorelay, if there is one, speaks for the main zone */
+	if(x == 0)
+		session->SetRelay(gCoreContext->GetSetting("pandora-relay").toUtf8().data());
+
+	connect(session, SIGNAL(Message(QString)),
+		this, SLOT(pianod_message(QString)), Qt::QueuedConnection);
+	connect(session, SIGNAL(PlaybackChanged(int, QString)),
+		this, SLOT(pianod_playback(int, QString)), Qt::QueuedConnection);
+	connect(session, SIGNAL(SongChanged(MythPianoSong)),
+		this, SLOT(pianod_song(MythPianoSong)), Qt::QueuedConnection);
+	connect(session, SIGNAL(StationsChanged(MythPianoStringList)),
+		this, SLOT(pianod_stations(MythPianoStringList)), Qt::QueuedConnection);
+	connect(session, SIGNAL(PlaylistChanged(MythPianoPlaylist)),
+		this, SLOT(pianod_playlist(MythPianoPlaylist)), Qt::QueuedConnection);
+	connect(session, SIGNAL(Disconnected(QString)),
+		this, SLOT(pianod_disconnected(QString)), Qt::QueuedConnection);
+	connect(session, SIGNAL(Reconnected()),
+		this, SLOT(pianod_reconnected()), Qt::QueuedConnection);
+	connect(session, SIGNAL(Rated(QString)),
+		this, SLOT(pianod_rated(QString)), Qt::QueuedConnection);
+	connect(session, SIGNAL(VolumeDone(bool)),
+		this, SLOT(pianod_volume(bool)), Qt::QueuedConnection);
+
+	connect(session, SIGNAL(PlaybackChanged(int, QString)),
+		zone, SLOT(zone_playback(int, QString)), Qt::QueuedConnection);
+	connect(session, SIGNAL(SongChanged(MythPianoSong)),
+		zone, SLOT(zone_song(MythPianoSong)), Qt::QueuedConnection);
+	connect(session, SIGNAL(StationsChanged(MythPianoStringList)),
+		zone, SLOT(zone_stations(MythPianoStringList)), Qt::QueuedConnection);
+	connect(session, SIGNAL(Disconnected(QString)),
+		zone, SLOT(zone_disconnected(QString)), Qt::QueuedConnection);
+  }
+
+  m_PlayerThread->start();
 }
 
 void MythPianoService::StopPlayerThread() {
-  if (m_Timer) {
-    m_Timer->stop();
-    m_Timer->disconnect();
-    delete m_Timer;
-    m_Timer = NULL;
+  if (!m_PlayerThread)
+    return;
+
+  m_Worker->Stop("Exiting plugin from Pianod");
+  /* nothing over there blocks, so this is plenty; never hang the frontend on it */
+  if(!m_PlayerThread->wait(5000)) {
+	LOG(VB_GENERAL, LOG_ERR, "MythPianod: pianod thread did not exit, leaving it behind");
+	m_PlayerThread->setParent(NULL);
+	m_PlayerThread = NULL;
+	m_Worker = NULL;
+	connected = 0;
+	zones.clear();
+	return;
   }
+
+  delete m_Worker;
+  delete m_PlayerThread;
+  m_Worker = NULL;
+  m_PlayerThread = NULL;
+  connected = 0;
+
+  for(int x = 0; x < (int) zones.size(); x++)
+	delete zones[x];
+  zones.clear();
 }
 
 void
@@ -429,30 +446,85 @@ MythPianoService::StopPlayback()
   SendPianodRequest(200);
 }
 
+/* 0-100; 100 is pianod playing at its own level, 0 is silence. */
 int
 MythPianoService::Volume()
 {
-  // 0-100;
-   /* Need to implement... */
-  return 0;
+  return volume_level;
 }
 
 void
 MythPianoService::VolumeUp()
 {
-   /* Need to implement... */
+  SetVolume((Muted() ? volume_unmute : volume_level) + 5);
 }
 
 void
 MythPianoService::VolumeDown()
 {
-   /* Need to implement... */
+  SetVolume((Muted() ? volume_unmute : volume_level) - 5);
 }
 
 void
 MythPianoService::ToggleMute()
 {
-   /* Need to implement... */
+  if(Muted()) {
+	int level = volume_unmute;
+	volume_unmute = -1;
+	SetVolume(level);
+  } else {
+	int level = volume_level;
+	SetVolume(0);
+	volume_unmute = level;
+  }
+}
+
+/*
+ * Only the level changes here, so the screen can show it straight away;
+ * pianod hears about it from flush_volume(), which sends wherever the
+ * level has got to by then as one absolute command.
+ */
+void
+MythPianoService::SetVolume(int level)
+{
+  volume_level = level < 0 ? 0 : level > 100 ? 100 : level;
+  volume_unmute = -1;
+  volume_set = 1;
+
+  if(!volume_busy && !m_VolumeTimer->isActive())
+	m_VolumeTimer->start();
+}
+
+void
+MythPianoService::flush_volume()
+{
+  /* volume_level starts out as a guess; don't push it on pianod unasked */
+  if(!connected || volume_busy || !volume_set || volume_level == volume_sent)
+	return;
+
+  /* pianod wants a gain in dB: 0 is as it comes, -100 is silent.
+     Spread ours over the top 40 dB, where the ear can tell the steps apart. */
+  int gain = volume_level ? (volume_level - 100) * 2 / 5 : -100;
+
+  rlen = snprintf(request, sizeof(request), "volume %d\n", gain);
+  if(SendPianodRequest(200, MythPianoCommand::Volume, "Failed to set volume!\n") < 0)
+	return;
+  volume_busy = 1;
+  volume_sent = volume_level;
+}
+
+void
+MythPianoService::pianod_volume(bool ok)
+{
+  if(!FromActiveZone())
+	return;
+  volume_busy = 0;
+  if(!ok)
+	volume_sent = -1;
+
+  /* the key was still held while that one was out */
+  if(volume_level != volume_sent && ok)
+	m_VolumeTimer->start();
 }
 
 void
@@ -463,75 +535,250 @@ MythPianoService::NextSong()
   SendPianodRequest(200);
 }
 
+/* Ask pianod for the current track; the answer arrives as pianod_song(). */
 int
-MythPianoService::service_heartbeat()
+MythPianoService::RequestStatus()
 {
   if(debug)
   printf("Determining current song...\n");
   rlen = sprintf(request, "status\n");
-  SendPianodRequest(204);
- 
-  /* parse current song */
-  if(response->back().code == 204) {
-	  for(int x = 0; x < response->size() - 1; x++) {
-	     MythPianoResponse r = response->at(x);
-	     if(response->at(x).code == 203) {
-		  map<string, string> song = PullOutSong(x + 1);
- 		  if(song.size() != 0) {
-		      if(debug)
-		      cout<<"Setting current song: " << song["Title"] << endl;
-		      if(!current_song.size() || (current_song["Title"] != song["Title"])) {
-			      current_song = song; 
-			      song_changed = 1;
-		      } else {
-			current_song["Rating"] = song["Rating"];
-			}
-			
-		  }
-	     }
-	  }
-  } else {
-	BroadcastMessage("Failed to get current song(2)!\n");
-        return -1;
+  if(SendPianodRequest(204, MythPianoCommand::Status) < 0)
+	return -1;
+  return 0;
+}
+
+void
+MythPianoService::pianod_message(QString message)
+{
+  if(!FromActiveZone())
+	return;
+  BroadcastMessage("%s", message.toUtf8().data());
+}
+
+void
+MythPianoService::pianod_playback(int code, QString value)
+{
+  if(!FromActiveZone())
+	return;
+  UpdatePlayback(code, value.toUtf8().data());
+}
+
+void
+MythPianoService::pianod_song(MythPianoSong song)
+{
+  if(!FromActiveZone())
+	return;
+  UpdateSong(song);
+}
+
+void
+MythPianoService::pianod_stations(MythPianoStringList list)
+{
+  if(!FromActiveZone())
+	return;
+  if(!stations.Update(list))
+	return;
+
+  /* keep pointing at the same station if it is still there */
+  current_station = -1;
+  if(current_station_name.size())
+	SetCurrentStation(QString(current_station_name.c_str()));
+  BroadcastMessage("New Stations");
+}
+
+void
+MythPianoService::pianod_playlist(MythPianoPlaylist list)
+{
+  if(!FromActiveZone())
+	return;
+  playlist = list;
+  BroadcastMessage("New Playlist");
+}
+
+void
+MythPianoService::pianod_disconnected(QString reason)
+{
+  if(!FromActiveZone())
+	return;
+  connected = 0;
+  play_state = 0;
+  ratings.Requeue();
+  /* a level pianod took stays taken; one on its way may not have got there */
+  if(volume_busy)
+	volume_sent = -1;
+  volume_busy = 0;
+  BroadcastMessage("%s", reason.toUtf8().data());
+}
+
+/* The I/O thread got us back in on its own; pick up where we were. */
+void
+MythPianoService::pianod_reconnected()
+{
+  if(!FromActiveZone())
+	return;
+  connected = 1;
+  BroadcastMessage("Reconnected to pianod.\n");
+
+  if(current_station_name.size()) {
+	rlen = snprintf(request, sizeof(request), "select station \"%s\"\nplay\n",
+			current_station_name.c_str());
+	if(rlen < (int) sizeof(request))
+		SendPianodRequest(200, MythPianoCommand::Plain, "Failed to resume playback!\n");
+  }
+
+  RequestStatus();
+  flush_ratings();
+  flush_volume();
+}
+
+/*
+ * Ratings go on the queue rather than the wire: they name the song, so
+ * they still mean the right thing if pianod is away and they go later.
+ */
+void MythPianoService::RateSong(const char *rating)
+{
+  string id = current_song.Get(MythPianoSong::ID);
+
+  if(id.empty()) {
+	BroadcastMessage("Nothing playing to rate.\n");
+	return;
   }
+  ratings.Rate(id, rating);
+  m_RatingTimer->start();
+}
 
+/* Send the next batch of ratings, if pianod is there to take them. */
+void MythPianoService::flush_ratings()
+{
+  static const int rating_batch = 16;
+  vector<string> commands;
+
+  if(!connected || !m_Worker)
+	return;
+
+  ratings.Next(rating_batch, &commands);
+  for(int x = 0; x < (int) commands.size(); x++) {
+	MythPianoCommand cmd(MythPianoCommand::Rate, 200, commands[x], "Failed to rate song!\n");
+	cmd.zone = active_zone;
+	if(!m_Worker->Post(cmd, 0))
+		ratings.Retry(commands[x]);
+  }
+  m_Worker->Wake();
+}
+
+void
+MythPianoService::pianod_rated(QString command)
+{
+  if(!FromActiveZone())
+	return;
+  ratings.Done(string(command.toUtf8().data()));
+
+  /* more than one batch's worth: the next goes once this one is through */
+  if(ratings.Waiting() && !m_RatingTimer->isActive())
+	m_RatingTimer->start();
+}
+
+void
+MythPianoService::UpdateSong(const MythPianoSong &song)
+{
   if(debug)
-  printf("Checking for status....current_station %d \n", current_station);
-  CheckForResponse(101, 102, 103, 104, 1);
-  MythPianoResponse r = response->back();
-
-  if(r.code == 101 || r.code == 102 || r.code == 104) {
-	size_t pos = r.value.find("/");
- 	played = r.value.substr(0, pos);
-	string rest = r.value.substr(pos + 1);
-	pos = rest.find("/");
-	duration = rest.substr(0, pos);
-	if(current_station == -1) {
-		pos = r.value.find(" ");
-		rest = r.value.substr(pos + 1);
-		pos = rest.find(" ");
-		rest = rest.substr(pos + 1);
-		pos = rest.find(" ");
-		current_station_name = rest.substr(pos + 1);
-		SetCurrentStation(QString(current_station_name.c_str()));
-		if(debug)
-		cout << "current station is " + current_station_name << " " << current_station << endl;
+  cout<<"Setting current song: " << song.Get(MythPianoSong::Title) << endl;
+  if(current_song.Empty() || current_song.Identity() != song.Identity()) {
+	current_song = song; 
+	song_changed = MythPianoSong::AllFields;
+	if(intertrack_started) {
+		GetMythPianoStats()->GapTime(MythPianoStats::TrackShown,
+					     MythPianoStats::Now() - intertrack_started);
+		intertrack_started = 0;
 	}
-  } else if(r.code == 103) {
+	BroadcastMessage("New Song");
+	/* find out what comes next so its art can be fetched early */
+	GetPlaylist();
+  } else {
+	/* same track, pick up whatever moved (usually just the rating) */
+	song_changed |= current_song.Diff(song);
+	current_song = song;
+  }
+}
+
+static int ParseTime(const string &t)
+{
+  int min, sec;
+
+  if(sscanf(t.c_str(), "%d:%d", &min, &sec) != 2)
+	return -1;
+  return min * 60 + sec;
+}
+
+void
+MythPianoService::UpdatePlayback(int code, const string &value)
+{
+  int was = play_state;
+
+  play_state = code;
+
+  /*
+   * pianod plays the audio, so the gap between tracks is its to close;
+   * what we can do is measure it, and not add to it on screen.
+   */
+  if(code == 104 && was != 104) {
+	intertrack_started = MythPianoStats::Now();
+	BroadcastMessage("Intertrack");
+  } else if(code == 101 && was == 104 && intertrack_started) {
+	uint64_t gap = MythPianoStats::Now() - intertrack_started;
+	last_gap_ms = gap / 1000;
+	GetMythPianoStats()->GapTime(MythPianoStats::Intertrack, gap);
+	LOG(VB_GENERAL, LOG_INFO, QString("MythPianod: %1 ms between tracks").arg(last_gap_ms));
+  } else if(code != 101 && code != 104) {
+	intertrack_started = 0;
+  }
+  if(code == 103) {
 	if(debug)
 	printf("pianod is stopped\n");
-  }  else {
-	BroadcastMessage("Failed to get duration of current song\n");
-	return -1;
+	return;
   }
 
- return 0; 
+  size_t pos = value.find("/");
+  played = value.substr(0, pos);
+  string rest = value.substr(pos + 1);
+  pos = rest.find("/");
+  duration = rest.substr(0, pos);
+  played_secs = ParseTime(played);
+  play_clock.start();
+
+  if(current_station == -1) {
+	pos = value.find(" ");
+	rest = value.substr(pos + 1);
+	pos = rest.find(" ");
+	rest = rest.substr(pos + 1);
+	pos = rest.find(" ");
+	current_station_name = rest.substr(pos + 1);
+	SetCurrentStation(QString(current_station_name.c_str()));
+	if(debug)
+	cout << "current station is " + current_station_name << " " << current_station << endl;
+  }
+
+  /* Coming out of a stop or an intertrack gap means a new song. */
+  if(code == 101 && was != 101 && was != 102)
+	RequestStatus();
 }
 
 void MythPianoService::GetTimes(string *play, string *dur)
 {
     *play   = played;
     *dur = duration;
+
+    /* pianod only tells us the position on changes; count along locally. */
+    if(play_state == 101 && played_secs >= 0) {
+	int secs = played_secs + play_clock.elapsed() / 1000;
+	int total = ParseTime(duration);
+	char buf[16];
+
+	if(total >= 0 && secs > total)
+		secs = total;
+	snprintf(buf, sizeof(buf), "%02d:%02d", secs / 60, secs % 60);
+	*play = buf;
+    }
 };
 
 
@@ -541,8 +788,7 @@ void MythPianoService::GetTimes(string *play, string *dur)
  */
 MythPianod::MythPianod(MythScreenStack *parent, QString name) :
   MythScreenType(parent, name),
-  m_coverArtFetcher(NULL),
-  m_coverArtTempFile(NULL),
+  m_coverArtLoader(NULL),
   m_Timer(NULL)
 {
   //example of how to find the configuration dir currently used.
@@ -554,43 +800,42 @@ MythPianod::~MythPianod()
 {
   MythPianoService* service = GetMythPianoService();
   service->RemoveMessageListener(this);
-  service->StopPlayerThread();
-
-  if (m_coverArtTempFile)
-    delete m_coverArtTempFile;
-
-  if (m_coverArtFetcher)
-    delete m_coverArtFetcher;
 }
 
 void MythPianod::Refresh() {
+    uint64_t started = MythPianoStats::Now();
     MythPianoService* service = GetMythPianoService();
-    if (service->GetCurrentSong().size()) {
-      if(service->SongChanged()) {
-	      m_songText->SetText(QString(service->GetCurrentSong()["Title"].c_str()));
-	      m_artistText->SetText(QString(service->GetCurrentSong()["Artist"].c_str()));
-	      m_albumText->SetText(QString(service->GetCurrentSong()["Album"].c_str()));
+    const MythPianoSong &song = service->GetCurrentSong();
+    if (!song.Empty()) {
+      unsigned int changed = service->SongChanged();
+
+      /* Only touch the widgets whose text actually moved; every SetText
+         costs a redraw. */
+      if(changed & MythPianoSong::Bit(MythPianoSong::Title))
+	      m_songText->SetText(QString(song.Get(MythPianoSong::Title).c_str()));
+      if(changed & MythPianoSong::Bit(MythPianoSong::Artist))
+	      m_artistText->SetText(QString(song.Get(MythPianoSong::Artist).c_str()));
+      if(changed & MythPianoSong::Bit(MythPianoSong::Album))
+	      m_albumText->SetText(QString(song.Get(MythPianoSong::Album).c_str()));
+      if(changed == MythPianoSong::AllFields)
               m_stationText->SetText(QString(service->GetCurrentStation().c_str()));
 
-	      // kick off cover art load
-	      if (m_coverArtFetcher)
-		delete m_coverArtFetcher;
-
-	      if (m_coverArtTempFile)
-		delete m_coverArtTempFile;
+      if(changed & MythPianoSong::Bit(MythPianoSong::CoverArt)) {
+	      m_coverArtUrl = song.Get(MythPianoSong::CoverArt).c_str();
 
-	      m_coverArtFetcher = new QHttp();
-	      connect(m_coverArtFetcher, SIGNAL(done(bool)), this, SLOT(coverArtFetched()));  
-	      QUrl u(service->GetCurrentSong()["CoverArt"].c_str());
-	      QHttp::ConnectionMode conn_mode = QHttp::ConnectionModeHttp;
-	      m_coverArtFetcher->setHost(u.host(), conn_mode, 80);
-	      QByteArray path = QUrl::toPercentEncoding(u.path(), "!$&'()*+,;=:@/");
-	      m_coverArtFetcher->get(path);
+	      // prefetched? then it goes up in the same frame as the title
+	      QImage image;
+	      if (m_coverArtLoader->Get(m_coverArtUrl, image))
+		ShowCoverArt(image);
+	      else
+		m_coverArtLoader->Request(m_coverArtUrl);
       }
 	  string played, duration;
 	  service->GetTimes(&played, &duration);
-	  string rating = service->GetCurrentSong()["Rating"];
-	  if(rating == "good") {
+	  const string &rating = song.Get(MythPianoSong::Rating);
+	  if(!(changed & MythPianoSong::Bit(MythPianoSong::Rating))) {
+		  /* nothing new to say */
+	  } else if(rating == "good") {
 		  m_ratingText->SetText(QString("This song makes me warm and fuzzy inside!"));
 	  } else if(rating == "bad") {
 		  m_ratingText->SetText(QString("Terrible song! Make it stop! Ahhh..."));
@@ -599,15 +844,22 @@ void MythPianod::Refresh() {
 	  } else {
 		cout<<"unknown rating: " << rating << endl;
 	  }
+	  QString time_string;
 	  if(played == "Intertrack") {
-		  QString time_string("00:00 / 00:00 Loading next track...");
-		  m_playTimeText->SetText(time_string);
+		  int gap = service->GetLastGap();
+		  time_string = "00:00 / 00:00 Loading next track...";
+		  if(gap >= 0)
+			  time_string += QString(" (last gap %1.%2s)").arg(gap / 1000).arg(gap % 1000 / 100);
 	  } else {
-		  QString time_string((played + " / " + duration).c_str());
+		  time_string = (played + " / " + duration).c_str();
+	  }
+	  if(time_string != m_shownTime) {
 		  m_playTimeText->SetText(time_string);
+		  m_shownTime = time_string;
 	  }
 
     }
+    GetMythPianoStats()->UiTime(MythPianoStats::Refresh, MythPianoStats::Now() - started);
 }
 
 void
@@ -615,26 +867,69 @@ MythPianod::RecvMessage(const char* message) {
   if (!strcmp(message, "New Song")) {
 	Refresh();
   }
+  else if (!strcmp(message, "New Playlist")) {
+	PrefetchCoverArt();
+  }
+  else if (!strcmp(message, "Intertrack")) {
+	ShowUpcoming();
+  }
   else if (m_outText)
     m_outText->SetText(QString(message));
 }
 
 void
-MythPianod::coverArtFetched(void)
+MythPianod::coverArtReady(QString url)
 {
-  QByteArray array = m_coverArtFetcher->readAll();
+  QImage image;
 
-  m_coverArtTempFile = new QTemporaryFile();
-  m_coverArtTempFile->open();
-  m_coverArtTempFile->write(array);
-  m_coverArtTempFile->flush();
-  m_coverArtTempFile->waitForBytesWritten(-1);
-  m_coverArtTempFile->close();
+  if (url == m_coverArtUrl && m_coverArtLoader->Get(url, image))
+    ShowCoverArt(image);
+}
 
-  QString filename = m_coverArtTempFile->fileName();
+void
+MythPianod::ShowCoverArt(const QImage &image)
+{
+  MythImage *mimage = GetPainter()->GetFormatImage();
+  mimage->Assign(image);
+  m_coverartImage->SetImage(mimage);
+  mimage->DecrRef();
+}
 
-  m_coverartImage->SetFilename(filename);
-  m_coverartImage->Load();
+/*
+ * pianod has gone quiet to fetch the next track. It is almost always the
+ * head of the queue we already have, so put that up now, art and all
+ * (prefetched by now); the status that follows the 101 only confirms it.
+ */
+void
+MythPianod::ShowUpcoming()
+{
+  const MythPianoPlaylist &queue = GetMythPianoService()->GetUpcoming();
+
+  if (queue.empty())
+    return;
+
+  const MythPianoSong &next = queue[0];
+  m_songText->SetText(QString(next.Get(MythPianoSong::Title).c_str()));
+  m_artistText->SetText(QString(next.Get(MythPianoSong::Artist).c_str()));
+  m_albumText->SetText(QString(next.Get(MythPianoSong::Album).c_str()));
+
+  m_coverArtUrl = next.Get(MythPianoSong::CoverArt).c_str();
+  QImage image;
+  if (m_coverArtLoader->Get(m_coverArtUrl, image))
+    ShowCoverArt(image);
+  else
+    m_coverArtLoader->Request(m_coverArtUrl);
+}
+
+/* Warm up the art for whatever pianod will play next. */
+void
+MythPianod::PrefetchCoverArt()
+{
+  const MythPianoPlaylist &queue = GetMythPianoService()->GetUpcoming();
+  int depth = gCoreContext->GetNumSetting("pandora-coverart-prefetch", 3);
+
+  for (int x = 0; x < (int) queue.size() && x < depth; x++)
+    m_coverArtLoader->Prefetch(queue[x].Get(MythPianoSong::CoverArt).c_str());
 }
 
 
@@ -664,7 +959,9 @@ bool MythPianod::Create(void)
   UIUtilE::Assign(this, m_loveBtn,     "loveBtn", &err);
   UIUtilE::Assign(this, m_tiredBtn,     "tiredBtn", &err);
   UIUtilE::Assign(this, m_stationsBtn,   "stationsBtn", &err);
+  UIUtilE::Assign(this, m_zonesBtn,      "zonesBtn", &err);
   UIUtilE::Assign(this, m_stationText,   "stationname", &err);
+  UIUtilE::Assign(this, m_volumeText,    "volume", &err);
 
   if (err) {
     LOG(VB_GENERAL, LOG_INFO, "Cannot load screen 'pandora'");
@@ -678,6 +975,7 @@ bool MythPianod::Create(void)
   connect(m_loveBtn, SIGNAL(Clicked()), this, SLOT(loveCallback()));
   connect(m_hateBtn, SIGNAL(Clicked()), this, SLOT(hateCallback()));
   connect(m_stationsBtn, SIGNAL(Clicked()), this, SLOT(selectStationCallback()));
+  connect(m_zonesBtn, SIGNAL(Clicked()), this, SLOT(selectZoneCallback()));
 
   BuildFocusList();
 
@@ -686,11 +984,17 @@ bool MythPianod::Create(void)
   m_coverartImage->SetFilename("/usr/share/app-install/icons/_usr_share_icons_hicolor_scalable_apps_emacs23.png");
   m_coverartImage->Load();
 
+  m_coverArtLoader = new MythPianoCoverArtLoader(this);
+  m_coverArtLoader->SetSize(m_coverartImage->GetArea().size());
+  connect(m_coverArtLoader, SIGNAL(Ready(QString)), this, SLOT(coverArtReady(QString)));
+
   MythPianoService* service = GetMythPianoService();
 
   service->SetMessageListener(this);
+  service->TouchSong();
 
   service->StartPlayerThread();
+  m_zonesBtn->SetVisible(service->GetZones().size() > 1);
 
   m_Timer = new QTimer(this);
   connect(m_Timer, SIGNAL(timeout()), this, SLOT(ui_heartbeat()));
@@ -700,6 +1004,18 @@ bool MythPianod::Create(void)
 }
 
 
+/* Straight from the service's idea of the level, before pianod has heard of it. */
+void
+MythPianod::ShowVolume()
+{
+  MythPianoService* service = GetMythPianoService();
+
+  if (service->Muted())
+    m_volumeText->SetText(QString("Muted"));
+  else
+    m_volumeText->SetText(QString("Volume: %1%").arg(service->Volume()));
+}
+
 void
 MythPianod::ui_heartbeat(void)
 {
@@ -728,7 +1044,6 @@ bool MythPianod::keyPressEvent(QKeyEvent *event)
 	if(GetScreenStack()->GetTopScreen() != this) {
            GetScreenStack()->PopScreen(false, true);
 	  service->StopPlayback();
-	  service->StopPlayerThread();
 	} else {
            GetScreenStack()->PopScreen(false, true);
 	   showStationSelectDialog();
@@ -753,21 +1068,26 @@ bool MythPianod::keyPressEvent(QKeyEvent *event)
  
     } else if (action == "MUTE")
 	{
-	  // XXX UI needed
 	  MythPianoService* service = GetMythPianoService();
 	  service->ToggleMute();
+	  ShowVolume();
 	}
     else if (action == "VOLUMEDOWN")
 	{
-	  // XXX UI needed
 	  MythPianoService* service = GetMythPianoService();
 	  service->VolumeDown();
+	  ShowVolume();
 	}
     else if (action == "VOLUMEUP")
 	{
-	  // XXX UI needed
 	  MythPianoService* service = GetMythPianoService();
 	  service->VolumeUp();
+	  ShowVolume();
+	}
+    else if (action == "STATS")
+	{
+	  MythPianoService* service = GetMythPianoService();
+	  service->DumpStats();
 	}
     else {
        if(debug)
@@ -790,7 +1110,6 @@ void MythPianod::logoutCallback()
 
   MythPianoService* service = GetMythPianoService();
   service->StopPlayback();
-  service->StopPlayerThread();
   service->Logout();
 
   GetScreenStack()->PopScreen(false, true);
@@ -812,14 +1131,12 @@ void MythPianod::loveCallback()
 }
 void MythPianod::hateCallback()
 {
-  GetMythPianoService()->HateSong();
-  GetMythPianoService()->SkipSong();
+  GetMythPianoService()->HateSong(true);
 }
 
 void MythPianod::tiredCallback()
 {
-  GetMythPianoService()->TiredSong();
-  GetMythPianoService()->SkipSong();
+  GetMythPianoService()->TiredSong(true);
 }
 
 void MythPianod::selectStationCallback()
@@ -828,6 +1145,12 @@ void MythPianod::selectStationCallback()
   showStationSelectDialog();
 }
 
+void MythPianod::selectZoneCallback()
+{
+  GetScreenStack()->PopScreen(false, true);
+  showZoneSelectDialog();
+}
+
 MythPianodConfig::MythPianodConfig(MythScreenStack *parent, QString name)
     : MythScreenType(parent, name)
 {
@@ -849,6 +1172,7 @@ bool MythPianodConfig::Create()
     return false;
 
   bool err = false;
+  UIUtilE::Assign(this, m_serverEdit,  "server",   &err);
   UIUtilE::Assign(this, m_nameEdit,    "username", &err);
   UIUtilE::Assign(this, m_passwordEdit,"password", &err);
   UIUtilE::Assign(this, m_loginBtn,    "loginBtn", &err);
@@ -866,7 +1190,12 @@ bool MythPianodConfig::Create()
 
   QString username = gCoreContext->GetSetting("pandora-username");
   QString password = gCoreContext->GetSetting("pandora-password");
+  QString host = gCoreContext->GetSetting("pandora-host", "127.0.0.1");
+  int port = gCoreContext->GetNumSetting("pandora-port", 4445);
 
+  if (host.contains(':'))
+    host = "[" + host + "]";
+  m_serverEdit->SetText(QString("%1:%2").arg(host).arg(port));
   m_nameEdit->SetText(username);
   m_passwordEdit->SetText(password);
 
@@ -920,6 +1249,16 @@ bool MythPianodConfig::keyPressEvent(QKeyEvent *event)
 
 void MythPianodConfig::loginCallback()
 {
+  QString host;
+  int port;
+
+  if (!ParseMythPianoServer(m_serverEdit->GetText(), &host, &port)) {
+    m_outText->SetText("Server should look like host:port");
+    return;
+  }
+
+  gCoreContext->SaveSetting("pandora-host", host);
+  gCoreContext->SaveSetting("pandora-port", QString::number(port));
   gCoreContext->SaveSetting("pandora-username", m_nameEdit->GetText());
   gCoreContext->SaveSetting("pandora-password", m_passwordEdit->GetText());
 
@@ -935,13 +1274,19 @@ void MythPianodConfig::loginCallback()
 }
 
 
+/* buttons made at a time; the rest wait until the user scrolls near them */
+static const int station_batch = 40;
+
 MythPianodStationSelect::MythPianodStationSelect(MythScreenStack *parent, QString name)
-  : MythScreenType(parent, name)
+  : MythScreenType(parent, name),
+    m_shown(0)
 {
 }
 
 MythPianodStationSelect::~MythPianodStationSelect()
 {
+  MythPianoService* service = GetMythPianoService();
+  service->RemoveMessageListener(this);
 }
 
 bool
@@ -957,6 +1302,7 @@ MythPianodStationSelect::Create(void)
 
   bool err = false;
   UIUtilE::Assign(this, m_stations, "stations", &err);
+  UIUtilE::Assign(this, m_filterText, "filter", &err);
 
   if (err) {
     LOG(VB_GENERAL, LOG_INFO, "Cannot load screen 'pandora'");
@@ -965,16 +1311,15 @@ MythPianodStationSelect::Create(void)
 
   BuildFocusList();
 
+  /* whatever the service has, cached or fresh; a newer list is merged in as it arrives */
   MythPianoService* service = GetMythPianoService();
-  vector<string> stations = service->GetStations();
-
-  for(int x = 0; x < stations.size(); x++) {
-    MythUIButtonListItem* item = new MythUIButtonListItem(m_stations, QString(stations[x].c_str()));
-    item->SetData(QString(stations[x].c_str()));
-  }
+  service->SetMessageListener(this);
+  UpdateStations();
 
   connect(m_stations, SIGNAL(itemClicked(MythUIButtonListItem*)),
 	  this, SLOT(stationSelectedCallback(MythUIButtonListItem*)));
+  connect(m_stations, SIGNAL(itemSelected(MythUIButtonListItem*)),
+	  this, SLOT(stationScrolledCallback(MythUIButtonListItem*)));
 
   return true;
 }
@@ -982,10 +1327,34 @@ MythPianodStationSelect::Create(void)
 bool
 MythPianodStationSelect::keyPressEvent(QKeyEvent *event)
 {
+  /* type-ahead: letters and digits narrow the list, backspace widens it */
+  QString text = event->text();
+  if (text.size() == 1 && text.at(0).isLetterOrNumber()) {
+    m_filter += text;
+    UpdateStations();
+    return true;
+  }
+  if (event->key() == Qt::Key_Backspace && !m_filter.isEmpty()) {
+    m_filter.chop(1);
+    UpdateStations();
+    return true;
+  }
+
   if (GetFocusWidget()->keyPressEvent(event))
     return true;
   
   bool handled = false;
+  QStringList actions;
+  handled = GetMythMainWindow()->TranslateKeyPress("Global", event, actions);
+
+  for (int i = 0; i < actions.size() && !handled; i++) {
+    /* the first escape just drops the search */
+    if (actions[i] == "ESCAPE" && !m_filter.isEmpty()) {
+      m_filter.clear();
+      UpdateStations();
+      handled = true;
+    }
+  }
   
   if (!handled && MythScreenType::keyPressEvent(event))
     handled = true;
@@ -993,6 +1362,74 @@ MythPianodStationSelect::keyPressEvent(QKeyEvent *event)
   return handled;
 }
 
+void
+MythPianodStationSelect::RecvMessage(const char* message)
+{
+  if (!strcmp(message, "New Stations"))
+    UpdateStations();
+}
+
+/* Work out which stations the search leaves, then show the first lot. */
+void
+MythPianodStationSelect::UpdateStations()
+{
+  GetMythPianoService()->GetStationList().Match(m_filter, &m_matches);
+  m_filterText->SetText(m_filter.isEmpty() ? QString("") : "Search: " + m_filter);
+  Populate(m_shown > station_batch ? m_shown : station_batch);
+}
+
+/* Make buttons for the next batch once the user gets near the last one. */
+void
+MythPianodStationSelect::stationScrolledCallback(MythUIButtonListItem *item)
+{
+  (void) item;
+  if (m_stations->GetCurrentPos() + station_batch / 2 >= m_stations->GetCount())
+    Populate(m_stations->GetCount() + station_batch);
+}
+
+/*
+ * Bring the button list in line with the first 'count' matches, touching
+ * only the buttons that differ, so a refresh or another letter of search
+ * does not throw away the user's place.
+ */
+void
+MythPianodStationSelect::Populate(int count)
+{
+  uint64_t started = MythPianoStats::Now();
+  const MythPianoStationList &stations = GetMythPianoService()->GetStationList();
+  QSet<QString> wanted;
+  int x;
+
+  if (count > (int) m_matches.size())
+    count = m_matches.size();
+  m_shown = count;
+
+  for(x = 0; x < count; x++)
+    wanted.insert(QString::fromUtf8(stations.Name(m_matches[x]).c_str()));
+
+  // drop the ones pianod no longer has, or the search rules out
+  for(x = m_stations->GetCount() - 1; x >= 0; x--) {
+    MythUIButtonListItem *item = m_stations->GetItemAt(x);
+    if (!wanted.contains(item->GetData().toString()))
+      m_stations->RemoveItem(item);
+  }
+
+  // then walk both in order, moving or adding where they disagree
+  for(x = 0; x < count; x++) {
+    QString name = QString::fromUtf8(stations.Name(m_matches[x]).c_str());
+    MythUIButtonListItem *item = m_stations->GetItemAt(x);
+
+    if (item && item->GetData().toString() == name)
+      continue;
+
+    MythUIButtonListItem *moved = m_stations->GetItemByData(name);
+    if (moved)
+      m_stations->RemoveItem(moved);
+    new MythUIButtonListItem(m_stations, name, name, x);
+  }
+  GetMythPianoStats()->UiTime(MythPianoStats::StationList, MythPianoStats::Now() - started);
+}
+
 void
 MythPianodStationSelect::stationSelectedCallback(MythUIButtonListItem *item)
 {
@@ -1002,3 +1439,90 @@ MythPianodStationSelect::stationSelectedCallback(MythUIButtonListItem *item)
   GetScreenStack()->PopScreen(false, true);
   showPlayerDialog();
 }
+
+
+MythPianodZoneSelect::MythPianodZoneSelect(MythScreenStack *parent, QString name)
+  : MythScreenType(parent, name)
+{
+}
+
+MythPianodZoneSelect::~MythPianodZoneSelect()
+{
+}
+
+bool
+MythPianodZoneSelect::Create(void)
+{
+  bool foundtheme = false;
+
+  // Load the theme for this screen
+  foundtheme = LoadWindowFromXML("pandora-ui.xml", "pandorazones", this);
+
+  if (!foundtheme)
+    return false;
+
+  bool err = false;
+  UIUtilE::Assign(this, m_zones, "zones", &err);
+
+  if (err) {
+    LOG(VB_GENERAL, LOG_INFO, "Cannot load screen 'pandorazones'");
+    return false;
+  }
+
+  BuildFocusList();
+
+  MythPianoService* service = GetMythPianoService();
+  const MythPianoZoneList &zones = service->GetZones();
+
+  for(int x = 0; x < (int) zones.size(); x++) {
+    MythUIButtonListItem* item = new MythUIButtonListItem(m_zones, zones[x]->Summary());
+    item->SetData(x);
+    // live now-playing: each zone says when it changes
+    connect(zones[x], SIGNAL(Changed()), this, SLOT(zoneChangedCallback()));
+  }
+  m_zones->SetItemCurrent(service->GetActiveZone());
+
+  connect(m_zones, SIGNAL(itemClicked(MythUIButtonListItem*)),
+	  this, SLOT(zoneSelectedCallback(MythUIButtonListItem*)));
+
+  return true;
+}
+
+bool
+MythPianodZoneSelect::keyPressEvent(QKeyEvent *event)
+{
+  if (GetFocusWidget()->keyPressEvent(event))
+    return true;
+  
+  bool handled = false;
+  
+  if (!handled && MythScreenType::keyPressEvent(event))
+    handled = true;
+  
+  return handled;
+}
+
+void
+MythPianodZoneSelect::zoneChangedCallback()
+{
+  const MythPianoZoneList &zones = GetMythPianoService()->GetZones();
+
+  for(int x = 0; x < (int) zones.size() && x < m_zones->GetCount(); x++)
+    m_zones->GetItemAt(x)->SetText(zones[x]->Summary());
+}
+
+void
+MythPianodZoneSelect::zoneSelectedCallback(MythUIButtonListItem *item)
+{
+  MythPianoService* service = GetMythPianoService();
+
+  service->SelectZone(item->GetData().toInt());
+
+  GetScreenStack()->PopScreen(false, true);
+  if (service->Login() != 0)
+    showLoginDialog();
+  else if (service->GetCurrentStation() == "")
+    showStationSelectDialog();
+  else
+    showPlayerDialog();
+}
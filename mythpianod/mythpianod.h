@@ -27,8 +27,9 @@ THE SOFTWARE.
 
 // MythTV headers
 #include <QTimer>
-#include <QHttp>
-#include <QTemporaryFile>
+#include <QTime>
+#include <QThread>
+#include <QImage>
 
 
 #include "mythscreentype.h"
@@ -36,15 +37,11 @@ THE SOFTWARE.
 #include "mythuibuttonlist.h"
 #include "mythuiimage.h"
 #include "mythuitextedit.h"
-#include "audiooutput.h"
-#include <pthread.h>
-
-extern "C" {
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-}
+#include "mythpianoworker.h"
+#include "mythpianocoverart.h"
+#include "mythpianozone.h"
+#include "mythpianostations.h"
+#include "mythpianoratings.h"
 
 class MythPianoService;
 MythPianoService * GetMythPianoService();
@@ -52,19 +49,9 @@ MythPianoService * GetMythPianoService();
 int showPopupDialog();
 int showLoginDialog();
 int showStationSelectDialog();
+int showZoneSelectDialog();
 int showPlayerDialog();
 
-class MythPianoResponse { 
-  public: 
-	int code; 
-	string value; 
-        MythPianoResponse(int c, string v) 
-	{
-		code = c;
-		value = v;
-	}
-};
-
 class MythPianoServiceListener
 {
  public:
@@ -93,6 +80,7 @@ class MythPianoService : public QObject
   void VolumeUp();
   void VolumeDown();
   int  Volume();
+  bool Muted() const { return volume_unmute != -1; };
   void ToggleMute();
 
   void BroadcastMessage(const char *format, ...);
@@ -100,50 +88,86 @@ class MythPianoService : public QObject
   void SetMessageListener(MythPianoServiceListener* listener);
   void RemoveMessageListener(MythPianoServiceListener* listener);
 
-  map<string, string> GetCurrentSong() { return current_song; };
-  int SongChanged() { if(song_changed) { song_changed = 0; return 1; } return 0;};
+  const MythPianoSong &GetCurrentSong() const { return current_song; };
+  /* MythPianoSong::Bit() mask of what changed since the last call */
+  unsigned int SongChanged() { unsigned int changed = song_changed; song_changed = 0; return changed; };
+  void TouchSong() { song_changed = MythPianoSong::AllFields; };
   void SkipSong() { rlen = sprintf(request, "skip\n"); SendPianodRequest(200); }
-  void TiredSong() { rlen = sprintf(request, "rate overplayed\n"); SendPianodRequest(200); }
-  void HateSong() { rlen = sprintf(request, "rate bad\n"); SendPianodRequest(200); }
-  void LoveSong() { rlen = sprintf(request, "rate good\n"); SendPianodRequest(200); }
-  void UnloveSong() { rlen = sprintf(request, "rate neutral\n"); SendPianodRequest(200); }
-  vector<string> GetStations() { return stations; };
-  string GetCurrentStation() { if(current_station != -1) return stations[current_station]; else return ""; };
+  void TiredSong(bool skip = false) { RateSong("overplayed"); if(skip) SkipSong(); }
+  void HateSong(bool skip = false) { RateSong("bad"); if(skip) SkipSong(); }
+  void LoveSong() { RateSong("good"); }
+  void UnloveSong() { RateSong("neutral"); }
+  const MythPianoPlaylist &GetUpcoming() const { return playlist; };
+  int GetLastGap() const { return last_gap_ms; };
+  const vector<string> &GetStations() const { return stations.Names(); };
+  const MythPianoStationList &GetStationList() const { return stations; };
+  string GetCurrentStation() { if(current_station != -1) return stations.Name(current_station); else return ""; };
   void GetTimes(string *played, string *duration);
   string	     current_station_name;
   int 		     current_station;
   void SetCurrentStation(QString name);
 
- private:
-  void CheckForResponse(int success1, int success2, int success3, int success4, int len);
-  map<string, string> PullOutSong(int idx);
-  std::vector<MythPianoResponse> *GetPianodLines(int success1, int success2, int success3, int success4);
-  int SendPianodRequest(int success);
-  void PianodDisconnect(std::string msg);
-  int RepopulateStations();
+  const MythPianoZoneList &GetZones() const { return zones; };
+  int GetActiveZone() const { return active_zone; };
+  void SelectZone(int zone);
 
-  pthread_t          m_PlayerThread;
+  void DumpStats();
 
-  int song_changed;
+ private:
+  int SendPianodRequest(int success, int kind = MythPianoCommand::Plain, const char *failure = NULL);
+  int RequestStatus();
+  void RateSong(const char *rating);
+  void SetVolume(int level);
+  void UpdatePlayback(int code, const string &value);
+  void UpdateSong(const MythPianoSong &song);
+  void ConnectZones(const string &auth);
+  bool FromActiveZone();
+
+  QThread*           m_PlayerThread;
+  MythPianoWorker*   m_Worker;
+  MythPianoZoneList  zones;
+  int                active_zone;
+  int                connected;
+
+  unsigned int song_changed;
   string duration;
   string played;
-  map<string, string> current_song;
-  vector<map<string,string> > playlist;
-  vector<string>     stations;
+  int play_state;
+  uint64_t intertrack_started;
+  int last_gap_ms;
+  int played_secs;
+  QTime play_clock;
+  MythPianoSong      current_song;
+  MythPianoPlaylist  playlist;
+  MythPianoStationList stations;
+  MythPianoRatingQueue ratings;
+  QTimer            *m_RatingTimer;
+  QTimer            *m_StatsTimer;
+
+  int                volume_level;   /* 0-100, what the user sees */
+  int                volume_sent;    /* what pianod was last told, -1 if not yet */
+  int                volume_unmute;  /* level to go back to, -1 if not muted */
+  int                volume_busy;    /* a volume command is on its way */
+  int                volume_set;     /* the user picked a level; until then pianod keeps its own */
+  QTimer            *m_VolumeTimer;
 
   MythPianoServiceListener* m_Listener;
 
-  QTimer*            m_Timer;
-  vector<MythPianoResponse> *response;
-  
-  struct sockaddr_in pianod_addr;
-  char * pianod_ip;
-  int pianod_port;
-  int pianod_fd;
   char request[1000];
   int rlen;
   private slots:
-  int service_heartbeat(void);
+  void pianod_message(QString message);
+  void pianod_playback(int code, QString value);
+  void pianod_song(MythPianoSong song);
+  void pianod_stations(MythPianoStringList list);
+  void pianod_playlist(MythPianoPlaylist list);
+  void pianod_disconnected(QString reason);
+  void pianod_reconnected();
+  void pianod_rated(QString command);
+  void flush_ratings();
+  void log_stats();
+  void flush_volume();
+  void pianod_volume(bool ok);
 };
 
 /** \class MythPianod
@@ -162,6 +186,10 @@ class MythPianod : public MythScreenType, public MythPianoServiceListener
 
   private:
     void Refresh();
+    void ShowCoverArt(const QImage &image);
+    void PrefetchCoverArt();
+    void ShowVolume();
+    void ShowUpcoming();
     MythUIText     *m_titleText;
     MythUIText     *m_songText;
     MythUIText     *m_artistText;
@@ -169,6 +197,7 @@ class MythPianod : public MythScreenType, public MythPianoServiceListener
     MythUIText     *m_playTimeText;
     MythUIText     *m_ratingText;
     MythUIText     *m_stationText;
+    MythUIText     *m_volumeText;
     MythUIButton   *m_unloveBtn;
     MythUIButton   *m_logoutBtn;
     MythUIButton   *m_skipBtn;
@@ -176,17 +205,19 @@ class MythPianod : public MythScreenType, public MythPianoServiceListener
     MythUIButton   *m_loveBtn;
     MythUIButton   *m_hateBtn;
     MythUIButton   *m_stationsBtn;
+    MythUIButton   *m_zonesBtn;
     MythUIText     *m_outText;
     MythUIImage    *m_coverartImage;
+    QString         m_shownTime;
       
-    QHttp          *m_coverArtFetcher;
-    QTemporaryFile *m_coverArtTempFile;
+    MythPianoCoverArtLoader *m_coverArtLoader;
+    QString         m_coverArtUrl;
     QTimer         *m_Timer;
 
   private slots:
     QString getTimeString(int exTime, int maxTime);
     void ui_heartbeat(void);
-    void coverArtFetched(void);
+    void coverArtReady(QString url);
     void unloveCallback();
     void logoutCallback();
     void skipCallback();
@@ -194,6 +225,7 @@ class MythPianod : public MythScreenType, public MythPianoServiceListener
     void loveCallback();
     void tiredCallback();
     void selectStationCallback();
+    void selectZoneCallback();
 };
 
 
@@ -212,6 +244,7 @@ class MythPianodConfig : public MythScreenType, public MythPianoServiceListener
     }
 
   private:
+    MythUITextEdit   *m_serverEdit;
     MythUITextEdit   *m_nameEdit;
     MythUITextEdit   *m_passwordEdit;
     MythUIText       *m_outText;
@@ -236,7 +269,7 @@ class MythPianodPopup : public MythScreenType
 };
 
 
-class MythPianodStationSelect : public MythScreenType
+class MythPianodStationSelect : public MythScreenType, public MythPianoServiceListener
 {
   Q_OBJECT
   public:
@@ -246,11 +279,38 @@ class MythPianodStationSelect : public MythScreenType
     bool Create(void);
     bool keyPressEvent(QKeyEvent *);
 
+    void RecvMessage(const char* message);
+
   private:
+    void UpdateStations();
+    void Populate(int count);
     MythUIButtonList *m_stations;    
+    MythUIText       *m_filterText;
+    QString           m_filter;
+    vector<int>       m_matches;
+    int               m_shown;
 
    private slots:
     void stationSelectedCallback(MythUIButtonListItem *item);
+    void stationScrolledCallback(MythUIButtonListItem *item);
+};
+
+class MythPianodZoneSelect : public MythScreenType
+{
+  Q_OBJECT
+  public:
+    MythPianodZoneSelect(MythScreenStack *parent, QString name);
+    ~MythPianodZoneSelect();
+  
+    bool Create(void);
+    bool keyPressEvent(QKeyEvent *);
+
+  private:
+    MythUIButtonList *m_zones;    
+
+   private slots:
+    void zoneChangedCallback();
+    void zoneSelectedCallback(MythUIButtonListItem *item);
 };
 
 #endif /* MYTHPANDORA_H */
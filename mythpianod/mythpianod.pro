@@ -25,6 +25,12 @@ LIBS += -lgnutls
 
 # Input
 HEADERS += config.h mythpianod.h
+HEADERS += mythpianoparser.h mythpianoresponse.h mythpianosong.h
+HEADERS += mythpianoqueue.h mythpianosession.h mythpianoworker.h
+HEADERS += mythpianocoverart.h mythpianozone.h mythpianostations.h mythpianoratings.h mythpianostats.h mythpianotrace.h
 SOURCES += main.cpp mythpianod.cpp
+SOURCES += mythpianoparser.cpp mythpianoresponse.cpp mythpianosong.cpp
+SOURCES += mythpianosession.cpp mythpianoworker.cpp
+SOURCES += mythpianocoverart.cpp mythpianozone.cpp mythpianostations.cpp mythpianoratings.cpp mythpianostats.cpp mythpianotrace.cpp
 
 include ( ../../libs-targetfix.pro )
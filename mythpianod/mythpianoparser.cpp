@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <errno.h>
+#include <string.h>
+
+// MythPianod headers
+#include "mythpianoparser.h"
+
+MythPianoParser::MythPianoParser(MythPianoParserListener *listener, int max_line)
+  : m_Listener(listener),
+    m_MaxLine(max_line),
+    m_InData(0),
+    m_Reset(0)
+{
+  m_Carry.reserve(max_line);
+}
+
+/* Forget any partial line. Safe to call from inside the listener. */
+void MythPianoParser::Reset()
+{
+  m_Carry.clear();
+  m_InData = 0;
+  m_Reset = 1;
+}
+
+/*
+ * Returns 0 when everything was consumed (a trailing partial line is kept
+ * for next time) and -1 with ENOBUFS if a line is longer than max_line.
+ * If the listener resets the parser, the rest of the chunk is dropped.
+ */
+int MythPianoParser::Feed(const char *data, int length)
+{
+  m_Reset = 0;
+
+  while(length > 0) {
+	const char *eol = (const char *) memchr(data, '\n', length);
+	int n = eol ? eol - data : length;
+
+	if((int) m_Carry.size() + n > m_MaxLine) {
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	if(!eol) {
+		m_Carry.append(data, n);
+		return 0;
+	}
+
+	if(m_Carry.empty()) {
+		Line(data, n);
+	} else {
+		m_Carry.append(data, n);
+		Line(m_Carry.data(), m_Carry.size());
+		m_Carry.clear();
+	}
+
+	if(m_Reset)
+		return 0;
+
+	data = eol + 1;
+	length -= n + 1;
+  }
+
+  return 0;
+}
+
+void MythPianoParser::Line(const char *line, int length)
+{
+  MythPianoEvent event;
+
+  if(length && line[length - 1] == '\r')
+	length--;
+
+  if(length < 3 || line[0] < '0' || line[0] > '9' || line[1] < '0' ||
+     line[1] > '9' || line[2] < '0' || line[2] > '9' ||
+     (length > 3 && line[3] != ' ')) {
+	event.type = MythPianoEvent::Malformed;
+	event.code = 0;
+	event.value = line;
+	event.length = length;
+	m_Listener->ParsedEvent(event);
+	return;
+  }
+
+  event.code = (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0');
+  event.value = length > 4 ? line + 4 : "";
+  event.length = length > 4 ? length - 4 : 0;
+
+  if(event.code == 100) {
+	event.type = MythPianoEvent::Welcome;
+  } else if(event.code >= 101 && event.code <= 104) {
+	event.type = MythPianoEvent::Playback;
+  } else if(event.code == 203) {
+	event.type = MythPianoEvent::DataStart;
+	m_InData = 1;
+  } else if(event.code > 104 && event.code < 200) {
+	event.type = MythPianoEvent::Field;
+  } else if(event.code >= 200 && event.code <= 299) {
+	event.type = m_InData ? MythPianoEvent::DataEnd : MythPianoEvent::Success;
+	m_InData = 0;
+  } else if(event.code >= 400 && event.code <= 499) {
+	event.type = MythPianoEvent::Error;
+	m_InData = 0;
+  } else {
+	event.type = MythPianoEvent::Unknown;
+  }
+
+  m_Listener->ParsedEvent(event);
+}
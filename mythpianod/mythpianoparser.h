@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOPARSER_H
+#define MYTHPIANOPARSER_H
+
+#include <string>
+
+/*
+ * One classified line of pianod output. value/length is the text after
+ * the "NNN " code; it points into the parser's input and is only good
+ * for the duration of the callback.
+ */
+class MythPianoEvent
+{
+ public:
+  enum Type {
+    Welcome,      /* 100 greeting */
+    Playback,     /* 101..104 playing/paused/stopped/intertrack */
+    DataStart,    /* 203, a block of fields follows */
+    Field,        /* 105..199 "Key: value" */
+    DataEnd,      /* 2xx closing a 203 block, normally 204 */
+    Success,      /* any other 2xx */
+    Error,        /* 4xx */
+    Unknown,      /* well formed, but a code we don't know */
+    Malformed     /* no three digit code at all */
+  };
+
+  int         type;
+  int         code;
+  const char *value;
+  int         length;
+};
+
+class MythPianoParserListener
+{
+ public:
+  virtual ~MythPianoParserListener() {}
+  virtual void ParsedEvent(const MythPianoEvent &event) = 0;
+};
+
+/*
+ * Incremental pianod protocol parser. Feed() takes bytes in whatever
+ * chunks the socket delivers, frames them into lines and hands each one
+ * to the listener as a typed event. Complete lines are passed on as
+ * views into the caller's buffer; only a line split across two chunks is
+ * copied, and no line may grow beyond max_line bytes.
+ *
+ * It knows nothing about commands: deciding which terminator ends which
+ * reply is up to the listener.
+ */
+class MythPianoParser
+{
+ public:
+  MythPianoParser(MythPianoParserListener *listener, int max_line = 4096);
+
+  void Reset();
+  int  Feed(const char *data, int length);
+  int  InData() const { return m_InData; }
+
+ private:
+  MythPianoParser(const MythPianoParser &);
+  MythPianoParser &operator=(const MythPianoParser &);
+
+  void Line(const char *line, int length);
+
+  MythPianoParserListener *m_Listener;
+  int                      m_MaxLine;
+  std::string              m_Carry;
+  int                      m_InData;
+  int                      m_Reset;
+};
+
+#endif /* MYTHPIANOPARSER_H */
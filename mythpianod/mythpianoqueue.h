@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOQUEUE_H
+#define MYTHPIANOQUEUE_H
+
+#include <QAtomicInt>
+
+/*
+ * Fixed-size single-producer, single-consumer ring.
+ *
+ * The GUI thread is the only producer and the pianod I/O thread the only
+ * consumer, so each side owns one index and publishes it with a release
+ * store; neither side ever takes a lock. One slot is kept empty to tell a
+ * full ring from an empty one.
+ */
+template <class T, int N>
+class MythPianoQueue
+{
+ public:
+  MythPianoQueue() : m_Head(0), m_Tail(0) {}
+
+  /* Producer side. Returns false if the consumer has fallen N-1 behind. */
+  bool Push(const T &item)
+  {
+    int tail = m_Tail;
+    int next = (tail + 1) % N;
+
+    if (next == m_Head.fetchAndAddAcquire(0))
+      return false;
+
+    m_Ring[tail] = item;
+    m_Tail.fetchAndStoreRelease(next);
+    return true;
+  }
+
+  /* Consumer side. Returns false if there is nothing to take. */
+  bool Pop(T &item)
+  {
+    int head = m_Head;
+
+    if (head == m_Tail.fetchAndAddAcquire(0))
+      return false;
+
+    item = m_Ring[head];
+    m_Ring[head] = T();
+    m_Head.fetchAndStoreRelease((head + 1) % N);
+    return true;
+  }
+
+ private:
+  T          m_Ring[N];
+  QAtomicInt m_Head;
+  QAtomicInt m_Tail;
+};
+
+#endif /* MYTHPIANOQUEUE_H */
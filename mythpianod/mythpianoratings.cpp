@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QCryptographicHash>
+
+// MythTV headers
+#include "mythcontext.h"
+#include "mythdirs.h"
+
+// MythPianod headers
+#include "mythpianoratings.h"
+
+/* One queue per server and pianod user, next to the station cache. */
+void MythPianoRatingQueue::SetKey(const QString &server, const QString &user)
+{
+  QString dir = GetConfDir() + "/MythPianod/ratings";
+  QByteArray key = QCryptographicHash::hash((server + "\n" + user).toUtf8(),
+					    QCryptographicHash::Sha1).toHex();
+  QString file = dir + "/" + QString(key);
+
+  if (file == m_File)
+    return;
+
+  QDir().mkpath(dir);
+  m_File = file;
+  Load();
+}
+
+/* Last rating wins; a song already on its way is sent again. */
+void MythPianoRatingQueue::Rate(const std::string &id, const std::string &rating)
+{
+  for (size_t x = 0; x < m_Entries.size(); x++) {
+    if (m_Entries[x].id == id) {
+      if (m_Entries[x].rating != rating) {
+        m_Entries[x].rating = rating;
+        m_Entries[x].sent = 0;
+        Save();
+      }
+      return;
+    }
+  }
+
+  Entry entry;
+  entry.id = id;
+  entry.rating = rating;
+  entry.sent = 0;
+  m_Entries.push_back(entry);
+  Save();
+}
+
+/* Up to 'max' waiting ratings as pianod commands, oldest first; they count as sent. */
+int MythPianoRatingQueue::Next(int max, std::vector<std::string> *commands)
+{
+  commands->clear();
+  for (size_t x = 0; x < m_Entries.size() && (int) commands->size() < max; x++) {
+    if (m_Entries[x].sent)
+      continue;
+    m_Entries[x].sent = 1;
+    commands->push_back(m_Entries[x].Command());
+  }
+  return commands->size();
+}
+
+/*
+ * pianod answered 'command'. If the song has been rated differently
+ * since, the entry no longer matches and stays for its own answer.
+ */
+void MythPianoRatingQueue::Done(const std::string &command)
+{
+  for (size_t x = 0; x < m_Entries.size(); x++) {
+    if (m_Entries[x].sent && m_Entries[x].Command() == command) {
+      m_Entries.erase(m_Entries.begin() + x);
+      Save();
+      return;
+    }
+  }
+}
+
+/* 'command' never made it out; send it with the next batch. */
+void MythPianoRatingQueue::Retry(const std::string &command)
+{
+  for (size_t x = 0; x < m_Entries.size(); x++)
+    if (m_Entries[x].Command() == command)
+      m_Entries[x].sent = 0;
+}
+
+/* The connection went away with answers outstanding: send them all again. */
+void MythPianoRatingQueue::Requeue()
+{
+  for (size_t x = 0; x < m_Entries.size(); x++)
+    m_Entries[x].sent = 0;
+}
+
+int MythPianoRatingQueue::Waiting() const
+{
+  int waiting = 0;
+
+  for (size_t x = 0; x < m_Entries.size(); x++)
+    if (!m_Entries[x].sent)
+      waiting++;
+  return waiting;
+}
+
+/* One "rating id" per line; nothing we load has been sent yet. */
+bool MythPianoRatingQueue::Load()
+{
+  QFile file(m_File);
+
+  m_Entries.clear();
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+
+  while (!file.atEnd()) {
+    QByteArray line = file.readLine();
+    if (line.endsWith('\n'))
+      line.chop(1);
+
+    std::string text(line.constData(), line.size());
+    size_t space = text.find(' ');
+    if (space == std::string::npos || space + 1 == text.size())
+      continue;
+
+    Entry entry;
+    entry.rating = text.substr(0, space);
+    entry.id = text.substr(space + 1);
+    entry.sent = 0;
+    m_Entries.push_back(entry);
+  }
+
+  if (m_Entries.size())
+    LOG(VB_GENERAL, LOG_INFO, QString("MythPianod: %1 ratings left over from last time")
+	.arg((int) m_Entries.size()));
+  return true;
+}
+
+bool MythPianoRatingQueue::Save() const
+{
+  QString tmp = m_File + ".tmp";
+  QFile file(tmp);
+
+  if (m_File.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot write rating queue " + tmp);
+    return false;
+  }
+
+  for (size_t x = 0; x < m_Entries.size(); x++) {
+    std::string line = m_Entries[x].rating + " " + m_Entries[x].id + "\n";
+    file.write(line.data(), line.size());
+  }
+  file.close();
+
+  QFile::remove(m_File);
+  return QFile::rename(tmp, m_File);
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANORATINGS_H
+#define MYTHPIANORATINGS_H
+
+#include <string>
+#include <vector>
+
+#include <QString>
+
+/*
+ * Ratings the user has given but pianod has not yet confirmed. There is
+ * at most one entry per song: rating it again replaces the rating, so a
+ * burst of thumbs on the remote ends up as one command. The queue is
+ * kept on disk, so ratings given while pianod is away, or the frontend
+ * is restarted, still get there.
+ *
+ * An entry is either waiting or sent. Sent entries go when pianod says
+ * yes (or no, which retrying will not change); they go back to waiting
+ * if the connection drops first.
+ */
+class MythPianoRatingQueue
+{
+ public:
+  void SetKey(const QString &server, const QString &user);
+
+  void Rate(const std::string &id, const std::string &rating);
+  int  Next(int max, std::vector<std::string> *commands);
+  void Done(const std::string &command);
+  void Retry(const std::string &command);
+  void Requeue();
+
+  int  Waiting() const;
+  int  Size() const { return m_Entries.size(); }
+
+ private:
+  struct Entry {
+    std::string id;
+    std::string rating;
+    int         sent;
+    std::string Command() const { return "rate " + rating + " \"" + id + "\"\n"; }
+  };
+
+  bool Load();
+  bool Save() const;
+
+  QString            m_File;
+  std::vector<Entry> m_Entries;
+};
+
+#endif /* MYTHPIANORATINGS_H */
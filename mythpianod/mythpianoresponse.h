@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANORESPONSE_H
+#define MYTHPIANORESPONSE_H
+
+#include <string>
+#include <vector>
+
+/*
+ * The lines of one pianod reply, kept as (code, offset, length) records
+ * into a single contiguous block of text. Reset() empties it without
+ * giving the memory back, so once the buffer has grown to fit the
+ * biggest reply we see, collecting a reply costs no allocations at all.
+ *
+ * Every value is NUL-terminated inside the block, so Value() can be
+ * handed to the C string functions directly.
+ */
+class MythPianoResponse
+{
+ public:
+  MythPianoResponse() {}
+
+  void Reset() { m_Text.clear(); m_Lines.clear(); }
+  void Append(int code, const char *value, int length);
+
+  int  Size() const  { return m_Lines.size(); }
+  int  Bytes() const { return m_Text.size(); }
+  int  Code(int idx) const   { return m_Lines[idx].code; }
+  int  Length(int idx) const { return m_Lines[idx].length; }
+  const char *Value(int idx) const { return &m_Text[m_Lines[idx].offset]; }
+  std::string String(int idx) const
+  {
+    return std::string(Value(idx), Length(idx));
+  }
+
+ private:
+  struct Line {
+    int code;
+    int offset;
+    int length;
+  };
+
+  std::vector<char> m_Text;
+  std::vector<Line> m_Lines;
+};
+
+#endif /* MYTHPIANORESPONSE_H */
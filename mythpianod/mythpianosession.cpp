@@ -0,0 +1,1103 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+
+extern "C" {
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <net/if.h>
+}
+
+#include <vector>
+
+#include <iostream>
+
+#include <QMutexLocker>
+#include <QHostAddress>
+
+// MythPianod headers
+#include "mythpianosession.h"
+#include "mythpianostats.h"
+
+using namespace std;
+
+static int debug = 0;
+
+/* reconnect backoff bounds, in ms */
+static int retry_min = 1000;
+static int retry_max = 60000;
+
+MythPianoSession::MythPianoSession(QObject *parent)
+  : QObject(parent),
+    pianod_host("127.0.0.1"),
+    pianod_port(4445),
+    pianod_fd(-1),
+    pianod_parser(this),
+    m_Notifier(NULL),
+    m_Writable(NULL),
+    reply_lines(0),
+    reply_bytes(0),
+    block_pushed(0),
+    connect_timeout(10000),
+    connect_stagger(250),
+    reply_timeout(20000),
+    m_Stagger(new QTimer(this)),
+    m_ConnectDeadline(new QTimer(this)),
+    dialing(0),
+    dial_lookup(-1),
+    dial_port(0),
+    dial_next(0),
+    m_Retry(new QTimer(this)),
+    m_Deadline(new QTimer(this)),
+    retry_delay(0),
+    retry_seed(time(NULL) ^ getpid()),
+    reconnecting(0),
+    use_spare(0),
+    via_relay(0),
+    spare_fd(-1),
+    login_pending(0),
+    m_LoginResult(0)
+{
+  m_Retry->setSingleShot(true);
+  connect(m_Retry, SIGNAL(timeout()), this, SLOT(pianod_retry()));
+
+  m_Deadline->setSingleShot(true);
+  connect(m_Deadline, SIGNAL(timeout()), this, SLOT(pianod_timeout()));
+
+  m_Stagger->setSingleShot(true);
+  connect(m_Stagger, SIGNAL(timeout()), this, SLOT(pianod_stagger()));
+
+  m_ConnectDeadline->setSingleShot(true);
+  connect(m_ConnectDeadline, SIGNAL(timeout()), this, SLOT(pianod_connect_timeout()));
+}
+
+MythPianoSession::~MythPianoSession()
+{
+  CancelDial();
+  if(pianod_fd != -1)
+	close(pianod_fd);
+  if(spare_fd != -1)
+	close(spare_fd);
+}
+
+/*
+ * GUI thread, before the I/O thread starts: give up connecting after
+ * connect_ms, racing another address every stagger_ms, and hang up if
+ * pianod takes longer than reply_ms to answer.
+ */
+void MythPianoSession::SetTimeouts(int connect_ms, int stagger_ms, int reply_ms)
+{
+  connect_timeout = connect_ms;
+  connect_stagger = stagger_ms;
+  reply_timeout = reply_ms;
+}
+
+/* GUI thread: where the next connection should go. */
+void MythPianoSession::SetServer(const string &host, int port)
+{
+  QMutexLocker locker(&m_LoginLock);
+  pianod_host = host;
+  pianod_port = port;
+}
+
+/* GUI thread: a mythpianorelay socket to try before going to pianod. */
+void MythPianoSession::SetRelay(const string &path)
+{
+  QMutexLocker locker(&m_LoginLock);
+  relay_path = path;
+}
+
+/*
+ * If a relay is running it already holds a connection to pianod for
+ * everyone; use that. Returns -1 (and we dial pianod ourselves) if not.
+ */
+int MythPianoSession::DialRelay()
+{
+  struct sockaddr_un addr;
+  string path;
+  int fd;
+
+  {
+	QMutexLocker locker(&m_LoginLock);
+	path = relay_path;
+  }
+
+  if(path.empty() || path.size() >= sizeof(addr.sun_path))
+	return -1;
+
+  if((fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  if(::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+	if(debug)
+	perror("no pianod relay");
+	close(fd);
+	return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  if(debug)
+  printf("Using pianod relay at %s.\n", path.c_str());
+  return fd;
+}
+
+/* Start a non-blocking connect to one address. */
+static int StartConnect(const QHostAddress &address, int port)
+{
+  struct sockaddr_storage ss;
+  socklen_t len;
+
+  memset(&ss, 0, sizeof(ss));
+  if(address.protocol() == QAbstractSocket::IPv6Protocol) {
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &ss;
+	Q_IPV6ADDR ip = address.toIPv6Address();
+
+	sin6->sin6_family = AF_INET6;
+	sin6->sin6_port = htons(port);
+	memcpy(&sin6->sin6_addr, &ip, sizeof(sin6->sin6_addr));
+	/* link-local addresses need to know which interface they are on */
+	if(!address.scopeId().isEmpty() &&
+	   !(sin6->sin6_scope_id = if_nametoindex(address.scopeId().toUtf8().data())))
+		sin6->sin6_scope_id = address.scopeId().toUInt();
+	len = sizeof(*sin6);
+  } else {
+	struct sockaddr_in *sin = (struct sockaddr_in *) &ss;
+
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(port);
+	sin->sin_addr.s_addr = htonl(address.toIPv4Address());
+	len = sizeof(*sin);
+  }
+
+  int fd = ::socket(ss.ss_family, SOCK_STREAM, 0);
+
+  if(fd < 0) {
+	perror("could not open pianod socket");
+	return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  if(::connect(fd, (struct sockaddr *) &ss, len) < 0 && errno != EINPROGRESS) {
+	perror("could not connect to pianod server");
+	close(fd);
+	return -1;
+  }
+  return fd;
+}
+
+/*
+ * Start opening a TCP connection to pianod, for the live connection or
+ * the spare. Nothing here waits: all zones share this thread.
+ *
+ * QHostInfo looks the name up in its own thread. It may come back with
+ * several addresses, IPv6 and IPv4; we try them interleaved by family
+ * and don't wait for a slow one: every connect_stagger ms another
+ * attempt joins the race, and the first to complete wins. If nothing
+ * has after connect_timeout ms, we give up.
+ */
+void MythPianoSession::Dial(int what)
+{
+  if(dialing) {
+	/* a spare on its way is as good a start as any for the live one */
+	if(what == DialLive)
+		dialing = DialLive;
+	return;
+  }
+
+  {
+	QMutexLocker locker(&m_LoginLock);
+	dial_host = pianod_host;
+	dial_port = pianod_port;
+  }
+
+  dialing = what;
+  dial_order.clear();
+  dial_next = 0;
+  m_ConnectDeadline->start(connect_timeout);
+  dial_lookup = QHostInfo::lookupHost(QString::fromUtf8(dial_host.c_str()),
+				      this, SLOT(pianod_resolved(QHostInfo)));
+}
+
+void MythPianoSession::pianod_resolved(const QHostInfo &info)
+{
+  if(info.lookupId() != dial_lookup)
+	return;
+  dial_lookup = -1;
+
+  if(info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+	DialFailed("could not resolve pianod server " + dial_host + ": " +
+		   info.errorString().toUtf8().data());
+	return;
+  }
+
+  QList<QHostAddress> addresses = info.addresses(), v6, v4;
+  for(int x = 0; x < addresses.size(); x++)
+	(addresses[x].protocol() == QAbstractSocket::IPv6Protocol ? v6 : v4).append(addresses[x]);
+  for(int x = 0; x < v6.size() || x < v4.size(); x++) {
+	if(x < v6.size())
+		dial_order.push_back(v6[x]);
+	if(x < v4.size())
+		dial_order.push_back(v4[x]);
+  }
+
+  Attempt();
+}
+
+/* Put the next address into the race, or give up if none is left to try. */
+void MythPianoSession::Attempt()
+{
+  while(dial_next < dial_order.size()) {
+	int fd = StartConnect(dial_order[dial_next++], dial_port);
+
+	if(fd < 0)
+		continue;
+
+	QSocketNotifier *notifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(pianod_connected(int)));
+	dial_racing.push_back(notifier);
+
+	if(dial_next < dial_order.size())
+		m_Stagger->start(connect_stagger);
+	return;
+  }
+
+  if(dial_racing.empty())
+	DialFailed("could not connect to pianod server " + dial_host);
+}
+
+void MythPianoSession::pianod_stagger(void)
+{
+  Attempt();
+}
+
+/* One of the attempts has finished, one way or the other. */
+void MythPianoSession::pianod_connected(int fd)
+{
+  int soerr = 0;
+  socklen_t len = sizeof(soerr);
+
+  for(size_t x = 0; x < dial_racing.size(); x++) {
+	if(dial_racing[x]->socket() != fd)
+		continue;
+	dial_racing[x]->setEnabled(false);
+	dial_racing[x]->deleteLater();
+	dial_racing.erase(dial_racing.begin() + x);
+	break;
+  }
+
+  getsockopt(fd, SOL_SOCKET, SO_ERROR, &soerr, &len);
+  if(soerr) {
+	if(debug)
+	printf("pianod connect attempt failed: %s\n", strerror(soerr));
+	close(fd);
+	/* no point waiting out the stagger for an address that has already failed */
+	if(dial_next < dial_order.size()) {
+		m_Stagger->stop();
+		Attempt();
+	} else if(dial_racing.empty()) {
+		DialFailed("could not connect to pianod server " + dial_host);
+	}
+	return;
+  }
+
+  int what = dialing;
+  CancelDial();
+  if(what == DialSpare)
+	spare_fd = fd;
+  else
+	Connected(fd);
+}
+
+void MythPianoSession::pianod_connect_timeout(void)
+{
+  if(dialing)
+	DialFailed("timed out connecting to pianod server " + dial_host);
+}
+
+/* Stop whatever dialing is going on; the sockets still racing are closed. */
+void MythPianoSession::CancelDial()
+{
+  if(dial_lookup != -1) {
+	QHostInfo::abortHostLookup(dial_lookup);
+	dial_lookup = -1;
+  }
+
+  for(size_t x = 0; x < dial_racing.size(); x++) {
+	close(dial_racing[x]->socket());
+	dial_racing[x]->setEnabled(false);
+	dial_racing[x]->deleteLater();
+  }
+  dial_racing.clear();
+  dial_order.clear();
+  m_Stagger->stop();
+  m_ConnectDeadline->stop();
+  dialing = 0;
+}
+
+void MythPianoSession::DialFailed(const string &why)
+{
+  int what = dialing;
+
+  fprintf(stderr, "%s\n", why.c_str());
+  CancelDial();
+
+  /* a spare that can't be had just isn't there; the live connection is missed */
+  if(what == DialLive)
+	Disconnect("Could not connect to pianod\n");
+}
+
+/* The live connection is up: start listening, and say what we queued up meanwhile. */
+void MythPianoSession::Connected(int fd)
+{
+  pianod_fd = fd;
+  pianod_parser.Reset();
+
+  m_Notifier = new QSocketNotifier(pianod_fd, QSocketNotifier::Read, this);
+  connect(m_Notifier, SIGNAL(activated(int)), this, SLOT(pianod_readable()));
+  m_Writable = new QSocketNotifier(pianod_fd, QSocketNotifier::Write, this);
+  m_Writable->setEnabled(false);
+  connect(m_Writable, SIGNAL(activated(int)), this, SLOT(pianod_writable()));
+
+  /* one trace file per session, opened the first time there is something to put in it */
+  if(trace_path.size() && !trace.IsOpen())
+	trace.Open(trace_path);
+  if(trace.IsOpen()) {
+	char port[16];
+	m_LoginLock.lock();
+	snprintf(port, sizeof(port), ":%d", pianod_port);
+	string server = pianod_host + port;
+	m_LoginLock.unlock();
+	trace.Record(MythPianoTraceRecord::Connected, server);
+  }
+
+  /* the welcome is on its way without our asking; a relay that cannot
+     get to pianod may keep it to itself, so give that no longer than a dial */
+  if(!pending.empty() && pending.front().kind == MythPianoCommand::Welcome)
+	pending.front().sent = MythPianoStats::Now();
+  m_Deadline->start(via_relay ? connect_timeout : reply_timeout);
+
+  emit Message("Authenticating with pianod...\n");
+  Flush();
+}
+
+/*
+ * Connect and authenticate if we have to, then refresh the station
+ * list. The GUI thread is parked in WaitForLogin() until LoginDone(),
+ * which comes as soon as pianod has taken our credentials: the GUI has
+ * its cached list to show, the fresh one follows when it is in.
+ */
+void MythPianoSession::Login(const MythPianoCommand &auth)
+{
+  login_pending = 1;
+  m_Auth = auth;
+
+  /* the user is here now, no need to keep retrying behind their back */
+  m_Retry->stop();
+  retry_delay = 0;
+  reconnecting = 0;
+
+  /* a connection already on its way will authenticate with what it queued */
+  int opened = pianod_fd == -1 && dialing != DialLive;
+  if(opened)
+	Open();
+  else if(debug)
+	printf("Already connected.\n");
+
+  emit Message("Retrieving station list...\n");
+  Submit(MythPianoCommand(MythPianoCommand::Stations, 204, "stations list\n"));
+
+  /* nothing to authenticate, we are already logged in */
+  if(!opened && pianod_fd != -1)
+	LoginDone(0);
+}
+
+/*
+ * Queue up the welcome and our credentials, and get a connection for
+ * them: the spare if we have one, the relay if there is one, else dial.
+ * They go out once it is up; a failure to connect ends up in Disconnect().
+ */
+void MythPianoSession::Open()
+{
+  emit Message("Connecting to pianod...\n");
+
+  /* pianod greets us with 100 ... 200 before we say anything */
+  MythPianoCommand welcome(MythPianoCommand::Welcome, 200, "");
+  welcome.written = 1;
+  pending.push_back(welcome);
+
+  MythPianoCommand auth = m_Auth;
+  auth.written = 0;
+  pending.push_back(auth);
+
+  int fd = TakeSpare();
+  if(fd == -1 && (fd = DialRelay()) != -1)
+	via_relay = 1;
+  if(fd != -1)
+	Connected(fd);
+  else
+	Dial(DialLive);
+}
+
+/*
+ * The relay turned us away instead of saying hello, or hung up before
+ * it did: it has no pianod itself just now. Go to pianod directly with
+ * everything we had queued; none of it has been answered.
+ */
+void MythPianoSession::RelayFallback()
+{
+  cout << "pianod relay is not available, connecting directly" << endl;
+
+  CloseLive();
+  via_relay = 0;
+  pianod_parser.Reset();
+  response.Reset();
+  EndReply();
+
+  for(list<MythPianoCommand>::iterator it = pending.begin(); it != pending.end(); it++)
+	if(it->text.size())
+		it->written = 0;
+  if(pending.empty() || pending.front().kind != MythPianoCommand::Welcome) {
+	MythPianoCommand welcome(MythPianoCommand::Welcome, 200, "");
+	welcome.written = 1;
+	pending.push_front(welcome);
+  }
+
+  Dial(DialLive);
+}
+
+/*
+ * Lost pianod without being asked to hang up, e.g. because it was
+ * restarted. Try again after a jittered, exponentially growing delay, so
+ * a house full of frontends doesn't hammer it in lockstep.
+ */
+void MythPianoSession::ScheduleRetry()
+{
+  retry_delay = retry_delay ? retry_delay * 2 : retry_min;
+  if(retry_delay > retry_max)
+	retry_delay = retry_max;
+
+  /* somewhere between half and one and a half times the delay */
+  int delay = retry_delay / 2 + rand_r(&retry_seed) % (retry_delay + 1);
+
+  emit Message(QString("Lost pianod, retrying in %1 seconds...\n").arg((delay + 999) / 1000));
+  m_Retry->start(delay);
+}
+
+void MythPianoSession::pianod_retry(void)
+{
+  if(pianod_fd != -1 || dialing == DialLive)
+	return;
+
+  reconnecting = 1;
+  Open();
+  Submit(MythPianoCommand(MythPianoCommand::Stations, 204, "stations list\n"));
+  Flush();
+}
+
+/*
+ * Keep a second connection open and idle so a dropped one can be
+ * replaced without waiting for a TCP handshake. pianod says hello on it
+ * and then leaves it alone until we authenticate.
+ *
+ * It is dialed like any other connection, so it never holds up the live
+ * one, and only once that has nothing in flight: we get around to it
+ * when the last reply is in.
+ */
+void MythPianoSession::OpenSpare()
+{
+  if(use_spare && spare_fd == -1 && !dialing && pianod_fd != -1 && pending.empty())
+	Dial(DialSpare);
+}
+
+int MythPianoSession::TakeSpare()
+{
+  int fd = spare_fd;
+  struct pollfd pfd;
+
+  spare_fd = -1;
+  if(fd == -1)
+	return -1;
+
+  /* if pianod went away it took the spare with it */
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+#ifdef POLLRDHUP
+  pfd.events |= POLLRDHUP;
+#endif
+  pfd.revents = 0;
+  if(poll(&pfd, 1, 0) < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+#ifdef POLLRDHUP
+     || (pfd.revents & POLLRDHUP)
+#endif
+     ) {
+	close(fd);
+	return -1;
+  }
+
+  if(debug)
+  printf("Switching to spare pianod connection.\n");
+  return fd;
+}
+
+void MythPianoSession::LoginDone(int result)
+{
+  QMutexLocker locker(&m_LoginLock);
+  login_pending = 0;
+  m_LoginResult = result;
+  m_LoginDone.wakeAll();
+}
+
+void MythPianoSession::BeginLogin()
+{
+  QMutexLocker locker(&m_LoginLock);
+  m_LoginResult = 1;
+}
+
+/* Returns 0 once logged in, -1 on failure or if timeout ms pass first. */
+int MythPianoSession::WaitForLogin(unsigned long timeout)
+{
+  QMutexLocker locker(&m_LoginLock);
+
+  while(m_LoginResult == 1)
+	if(!m_LoginDone.wait(&m_LoginLock, timeout))
+		return -1;
+  return m_LoginResult;
+}
+
+void MythPianoSession::Submit(const MythPianoCommand &cmd)
+{
+  /* while connecting, commands wait in line behind the credentials */
+  if(pianod_fd == -1 && dialing != DialLive) {
+	if(debug)
+	printf("socket is closed. ignoring request.\n");
+	if(cmd.failure.size())
+		emit Message(QString(cmd.failure.c_str()));
+	return;
+  }
+
+  pending.push_back(cmd);
+}
+
+/*
+ * Put every submitted but unwritten command on the wire with as few
+ * writev() calls as possible. pianod answers in order, so there is no
+ * need to wait for one reply before sending the next command; ParsedEvent
+ * hands each reply to the oldest command still waiting for one. What a
+ * full send buffer won't take waits in pianod_out for pianod_writable().
+ */
+void MythPianoSession::Flush()
+{
+  list<MythPianoCommand>::iterator it = pending.begin();
+  uint64_t now = MythPianoStats::Now();
+
+  while(pianod_fd != -1) {
+	struct iovec iov[16];
+	ssize_t total = 0;
+	int n = 0;
+
+	for(; it != pending.end() && n < 16; it++) {
+		if(it->written)
+			continue;
+		it->written = 1;
+		it->sent = now;
+		if(it->text.empty())
+			continue;
+		iov[n].iov_base = (void *) it->text.data();
+		iov[n].iov_len = it->text.size();
+		total += it->text.size();
+		n++;
+	}
+
+	if(!n)
+		return;
+
+	for(int x = 0; x < n; x++)
+		trace.Record(MythPianoTraceRecord::Wrote, (const char *) iov[x].iov_base, iov[x].iov_len);
+	if(!m_Deadline->isActive())
+		m_Deadline->start(reply_timeout);
+
+	/* the socket is still busy with earlier commands; queue up behind them */
+	ssize_t len = 0;
+	if(pianod_out.empty()) {
+		len = writev(pianod_fd, iov, n);
+		if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			WriteFailed();
+			return;
+		}
+		if(len == total)
+			continue;
+		if(len < 0)
+			len = 0;
+	}
+
+	for(int x = 0; x < n; x++) {
+		size_t skip = (size_t) len < iov[x].iov_len ? len : iov[x].iov_len;
+		pianod_out.append((const char *) iov[x].iov_base + skip, iov[x].iov_len - skip);
+		len -= skip;
+	}
+	m_Writable->setEnabled(true);
+  }
+}
+
+/* Room in the send buffer again: carry on with what Flush() left over. */
+void MythPianoSession::pianod_writable(void)
+{
+  while(!pianod_out.empty()) {
+	ssize_t len = write(pianod_fd, pianod_out.data(), pianod_out.size());
+	if(len < 0 && errno == EINTR)
+		continue;
+	if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+	if(len <= 0) {
+		WriteFailed();
+		return;
+	}
+	pianod_out.erase(0, len);
+  }
+  m_Writable->setEnabled(false);
+}
+
+/* pianod can't be written to at all any more, e.g. it hung up on us. */
+void MythPianoSession::WriteFailed()
+{
+  perror("Failed to send pianod request");
+  if(via_relay && !pending.empty() && pending.front().kind == MythPianoCommand::Welcome) {
+	RelayFallback();
+	return;
+  }
+  Disconnect("Failed to send pianod request");
+}
+
+/* Say goodbye: flush whatever is still queued, then hang up. */
+void MythPianoSession::Shutdown(const string &msg)
+{
+  m_Retry->stop();
+  m_Deadline->stop();
+  Flush();
+  Disconnect(msg, 0);
+
+  if(spare_fd != -1) {
+	close(spare_fd);
+	spare_fd = -1;
+  }
+}
+
+/*
+ * Hang up. Unless we were asked to, the GUI thread is told why and we
+ * start trying to get back in, if we ever got in in the first place.
+ */
+void MythPianoSession::Disconnect(const string &msg, int notify)
+{
+  int was_open = pianod_fd != -1;
+  int retry = notify && !login_pending && m_Auth.text.size();
+
+  std::cout<<msg<<endl;
+
+  CancelDial();
+  via_relay = 0;
+
+  if(pianod_fd != -1) {
+	CloseLive();
+	GetMythPianoStats()->Disconnected();
+	/* only losing pianod goes in the trace; hanging up ourselves is the client's business */
+	if(notify)
+		trace.Record(MythPianoTraceRecord::Disconnected, msg);
+	trace.Flush();
+	if(notify)
+		emit Disconnected(QString(msg.c_str()));
+  }
+
+  pianod_parser.Reset();
+  pending.clear();
+  response.Reset();
+  EndReply();
+
+  if(login_pending)
+	LoginDone(-1);
+
+  if(retry && (was_open || reconnecting) && !m_Retry->isActive())
+	ScheduleRetry();
+}
+
+/* Stop listening to the live connection and close it. */
+void MythPianoSession::CloseLive()
+{
+  m_Deadline->stop();
+  if(m_Notifier) {
+	m_Notifier->setEnabled(false);
+	m_Notifier->deleteLater();
+	m_Notifier = NULL;
+  }
+  if(m_Writable) {
+	m_Writable->setEnabled(false);
+	m_Writable->deleteLater();
+	m_Writable = NULL;
+  }
+  pianod_out.clear();
+
+  if(pianod_fd != -1) {
+	close(pianod_fd);
+	pianod_fd = -1;
+  }
+}
+
+/* Returns the number of bytes read, 0 if nothing is there, -1 if gone. */
+int MythPianoSession::ReadPianod()
+{
+  int len;
+
+  do {
+	len = read(pianod_fd, pianod_buf, sizeof(pianod_buf));
+  } while(len < 0 && errno == EINTR);
+
+  if(len > 0) {
+	trace.Record(MythPianoTraceRecord::Read, pianod_buf, len);
+	return len;
+  }
+  if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	return 0;
+
+  if(len < 0)
+  perror("read");
+  if(via_relay && !pending.empty() && pending.front().kind == MythPianoCommand::Welcome) {
+	RelayFallback();
+	return -1;
+  }
+  Disconnect("Error getting response from pianod\n");
+  return -1;
+}
+
+void MythPianoSession::pianod_readable(void)
+{
+  int len = ReadPianod();
+
+  if(len > 0 && pianod_parser.Feed(pianod_buf, len) < 0) {
+	perror("pianod line");
+	Disconnect("Line from pianod is too long\n");
+	return;
+  }
+
+  /* pianod is talking; give it a fresh deadline if we still want more */
+  if(pianod_fd != -1 && !pending.empty() && pending.front().written)
+	m_Deadline->start(reply_timeout);
+  else
+	m_Deadline->stop();
+}
+
+void MythPianoSession::pianod_timeout(void)
+{
+  if(pianod_fd == -1)
+	return;
+  /* a relay that took us in but never said hello is as good as none */
+  if(via_relay && !pending.empty() && pending.front().kind == MythPianoCommand::Welcome) {
+	RelayFallback();
+	return;
+  }
+  Disconnect("pianod stopped answering\n");
+}
+
+/*
+ * event.value points into the receive buffer and is not NUL-terminated;
+ * it is only good until we return.
+ */
+void MythPianoSession::ParsedEvent(const MythPianoEvent &event)
+{
+  MythPianoCommand *cmd = NULL;
+  int code = event.code;
+  const char *value;
+
+  if(!pending.empty() && pending.front().written)
+	cmd = &pending.front();
+
+  if(event.type == MythPianoEvent::Welcome) {
+	if(debug)
+	printf("Ignoring welcome.\n");
+	return;
+  }
+
+  if(event.type == MythPianoEvent::Playback && (!cmd || cmd->success != code)) {
+	/* unsolicited playback notice, not part of any reply */
+	emit PlaybackChanged(code, QString::fromAscii(event.value, event.length));
+	return;
+  }
+
+  if(!cmd) {
+	HandleEvent(event);
+	return;
+  }
+
+  /* only the line at hand is kept; long replies are consumed as they come */
+  response.Reset();
+  response.Append(code, event.value, event.length);
+  value = response.Value(0);
+  reply_lines++;
+  reply_bytes += event.length + 1;
+  Stream(*cmd, event);
+
+  if(cmd->kind == MythPianoCommand::Stations && event.type == MythPianoEvent::DataEnd &&
+     block_pushed) {
+	/* the end of a track block pianod pushed, not of the listing */
+	block_pushed = 0;
+	block_stations.clear();
+	HandleEvent(event);
+	return;
+  }
+
+  switch(event.type) {
+  case MythPianoEvent::DataStart:
+	if(debug)
+	std::cout<<"Status code: " << code << " value: " << value << endl;
+	break;
+  case MythPianoEvent::Playback:
+  case MythPianoEvent::Field:
+	if(debug)
+	std::cout<<"Info code: " << code << " value: " << value << endl;
+	break;
+  case MythPianoEvent::DataEnd:
+  case MythPianoEvent::Success:
+	if(debug)
+	std::cout<<"Success code: " << code << " value: " << value << endl;
+	break;
+  case MythPianoEvent::Error:
+	std::cout<<"Error code: " << code << " value: " << value << endl;
+	break;
+  default:
+	std::cout<<"Unknown error: " << code << " value: " << value << endl;
+	break;
+  }
+
+  if(event.type == MythPianoEvent::Error)
+	Complete(0);
+  else if(code == cmd->success)
+	Complete(1);
+  else if(debug)
+	printf("Not stopping: %d != %d\n", code, cmd->success);
+}
+
+/*
+ * Lines that arrive while no command is waiting: the 203 ... 204 track
+ * block pianod pushes when a new song starts.
+ */
+void MythPianoSession::HandleEvent(const MythPianoEvent &event)
+{
+  switch(event.type) {
+  case MythPianoEvent::DataStart:
+	pending_song.Clear();
+	break;
+  case MythPianoEvent::Field:
+	if(pianod_parser.InData())
+		pending_song.SetField(event.value, event.length);
+	break;
+  case MythPianoEvent::DataEnd:
+	if(!pending_song.Empty())
+		emit SongChanged(pending_song);
+	break;
+  case MythPianoEvent::Error:
+	std::cout<<"Error code: " << event.code << " value: " << string(event.value, event.length) << endl;
+	break;
+  default:
+	if(debug)
+	std::cout<<"Ignoring code: " << event.code << " value: " << string(event.value, event.length) << endl;
+	break;
+  }
+}
+
+/*
+ * Take a reply apart line by line. Station and queue listings can run to
+ * hundreds of lines on big accounts; we only ever hold the one that just
+ * arrived plus the results built from it so far.
+ */
+void MythPianoSession::Stream(const MythPianoCommand &cmd, const MythPianoEvent &event)
+{
+  switch(cmd.kind) {
+  case MythPianoCommand::Stations:
+	/*
+	 * A track block pianod pushes before the listing has its own
+	 * "115 Station:"; a block only counts once it has proved to hold
+	 * nothing but station names. pending_song picks up the rest.
+	 */
+	if(event.type == MythPianoEvent::DataStart) {
+		EndStationBlock();
+		pending_song.Clear();
+	} else if(event.type == MythPianoEvent::Field) {
+		MythPianoStringList &to = pianod_parser.InData() ? block_stations : reply_stations;
+
+		/* remove the "Station: " */
+		if(event.code == 115 && event.length >= 9)
+			to.push_back(string(event.value + 9, event.length - 9));
+		else if(pianod_parser.InData())
+			block_pushed = 1;
+		if(pianod_parser.InData())
+			pending_song.SetField(event.value, event.length);
+	}
+	break;
+
+  case MythPianoCommand::Status:
+  case MythPianoCommand::Queue:
+	if(event.type == MythPianoEvent::DataStart) {
+		EndSong(cmd.kind);
+	} else if(event.type == MythPianoEvent::Field && pianod_parser.InData()) {
+		if(debug)
+		std::cout<<"Song: " << response.Value(0) << endl;
+		reply_song.SetField(event.value, event.length);
+	}
+	break;
+  }
+}
+
+/* A 203 block is over: file the song it described. */
+void MythPianoSession::EndSong(int kind)
+{
+  if(!reply_song.Empty()) {
+	if(kind == MythPianoCommand::Queue) {
+		cout<<"Storing new song: " << reply_song.Get(MythPianoSong::Title) << endl;
+		reply_playlist.push_back(reply_song);
+	} else {
+		emit SongChanged(reply_song);
+	}
+  }
+  reply_song.Clear();
+}
+
+/* A 203 block of a station listing is over: keep its names unless it was a track. */
+void MythPianoSession::EndStationBlock()
+{
+  if(!block_pushed)
+	reply_stations.insert(reply_stations.end(), block_stations.begin(), block_stations.end());
+  block_stations.clear();
+  block_pushed = 0;
+}
+
+void MythPianoSession::EndReply()
+{
+  reply_lines = 0;
+  reply_bytes = 0;
+  reply_song.Clear();
+  reply_playlist.clear();
+  reply_stations.clear();
+  block_stations.clear();
+  block_pushed = 0;
+}
+
+/* The reply to the command at the head of the queue is complete. */
+void MythPianoSession::Complete(int ok)
+{
+  MythPianoCommand cmd = pending.front();
+  string last = response.String(0);
+
+  pending.pop_front();
+  GetMythPianoStats()->Command(cmd.kind, ok, MythPianoStats::Now() - cmd.sent,
+			       reply_bytes, reply_lines);
+
+  if(!ok && cmd.failure.size())
+	emit Message(QString(cmd.failure.c_str()));
+
+  switch(cmd.kind) {
+  case MythPianoCommand::Welcome:
+	if(!ok || reply_lines != 1) {
+		if(via_relay) {
+			RelayFallback();
+			return;
+		}
+		Disconnect("Non-successful attempt on initial connection: " + last);
+		return;
+	}
+	break;
+
+  case MythPianoCommand::Login:
+	if(!ok) {
+		Disconnect("Authentication failed: " + last);
+		return;
+	}
+	emit Message("Connected to pianod.\n");
+	if(reconnecting) {
+		reconnecting = 0;
+		retry_delay = 0;
+		GetMythPianoStats()->Reconnected();
+		emit Reconnected();
+	}
+	if(login_pending)
+		LoginDone(0);
+	break;
+
+  case MythPianoCommand::Stations:
+	if(!ok) {
+		Disconnect("Failed to retrieve station list. Bailing: " + last);
+		return;
+	} else {
+		EndStationBlock();
+		std::cout<<"Got " << reply_stations.size() << " stations" << endl;
+		emit StationsChanged(reply_stations);
+	}
+	break;
+
+  case MythPianoCommand::Status:
+	if(ok)
+		EndSong(cmd.kind);
+	break;
+
+  case MythPianoCommand::Queue:
+	if(ok) {
+		EndSong(cmd.kind);
+		emit PlaylistChanged(reply_playlist);
+	}
+	break;
+
+  case MythPianoCommand::Volume:
+	emit VolumeDone(ok);
+	break;
+
+  case MythPianoCommand::Rate:
+	/* a refusal is final too; sending it again would not change the answer */
+	emit Rated(QString::fromUtf8(cmd.text.c_str()));
+	break;
+  }
+
+  response.Reset();
+  EndReply();
+
+  if(pending.empty())
+	OpenSpare();
+}
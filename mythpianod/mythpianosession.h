@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOSESSION_H
+#define MYTHPIANOSESSION_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <stdint.h>
+
+#include <QObject>
+#include <QString>
+#include <QMetaType>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QHostInfo>
+#include <QHostAddress>
+
+#include "mythpianoparser.h"
+#include "mythpianoresponse.h"
+#include "mythpianosong.h"
+#include "mythpianotrace.h"
+
+/*
+ * One request for the I/O thread. 'success' is the code that ends the
+ * reply (any 4xx ends it too), 'failure' is broadcast if it does not
+ * succeed and 'kind' says what to do with the reply once it is complete.
+ * 'zone' picks which pianod server it goes to; 'sent' is when it went
+ * out, in MythPianoStats::Now() microseconds.
+ */
+class MythPianoCommand
+{
+ public:
+  enum Kind {
+    Plain,
+    Welcome,
+    Login,
+    Status,
+    Stations,
+    Queue,
+    Rate,
+    Volume,
+    Shutdown
+  };
+
+  MythPianoCommand() : kind(Plain), zone(0), success(200), written(0), sent(0) {}
+  MythPianoCommand(int k, int s, const std::string &t,
+                   const std::string &f = std::string())
+    : kind(k), zone(0), success(s), text(t), failure(f), written(0), sent(0) {}
+
+  int         kind;
+  int         zone;
+  int         success;
+  std::string text;
+  std::string failure;
+  int         written;
+  uint64_t    sent;
+};
+
+typedef std::vector<std::string> MythPianoStringList;
+
+Q_DECLARE_METATYPE(MythPianoSong)
+Q_DECLARE_METATYPE(MythPianoStringList)
+Q_DECLARE_METATYPE(MythPianoPlaylist)
+
+/*
+ * The pianod connection itself. Lives in the I/O thread: it owns the
+ * socket, writes commands in the order they were submitted, matches each
+ * reply to its command and reports the results through signals, which
+ * the service receives as queued calls on the GUI thread.
+ */
+class MythPianoSession : public QObject, public MythPianoParserListener
+{
+  Q_OBJECT
+
+ public:
+  MythPianoSession(QObject *parent = NULL);
+  ~MythPianoSession();
+
+  /* I/O thread */
+  void Login(const MythPianoCommand &auth);
+  void Submit(const MythPianoCommand &cmd);
+  void Flush();
+  void Shutdown(const std::string &msg);
+
+  /* GUI thread, before the I/O thread starts */
+  void SetSpare(int spare) { use_spare = spare; }
+  void SetTrace(const std::string &path) { trace_path = path; }
+  void SetTimeouts(int connect_ms, int stagger_ms, int reply_ms);
+
+  /* GUI thread */
+  void SetServer(const std::string &host, int port);
+  void SetRelay(const std::string &path);
+  void BeginLogin();
+  int  WaitForLogin(unsigned long timeout);
+
+ signals:
+  void Message(QString message);
+  void PlaybackChanged(int code, QString value);
+  void SongChanged(MythPianoSong song);
+  void StationsChanged(MythPianoStringList stations);
+  void PlaylistChanged(MythPianoPlaylist playlist);
+  void Disconnected(QString reason);
+  void Reconnected(void);
+  void Rated(QString command);
+  void VolumeDone(bool ok);
+
+ private slots:
+  void pianod_readable(void);
+  void pianod_writable(void);
+  void pianod_retry(void);
+  void pianod_timeout(void);
+  void pianod_resolved(const QHostInfo &info);
+  void pianod_stagger(void);
+  void pianod_connected(int fd);
+  void pianod_connect_timeout(void);
+
+ private:
+  enum { DialLive = 1, DialSpare };
+
+  void Dial(int what);
+  void Attempt();
+  void CancelDial();
+  void DialFailed(const std::string &why);
+  void Connected(int fd);
+  int  DialRelay();
+  void RelayFallback();
+  void Open();
+  void CloseLive();
+  void WriteFailed();
+  void ScheduleRetry();
+  void OpenSpare();
+  int  TakeSpare();
+  int  ReadPianod();
+  void Disconnect(const std::string &msg, int notify = 1);
+  void ParsedEvent(const MythPianoEvent &event);
+  void HandleEvent(const MythPianoEvent &event);
+  void Stream(const MythPianoCommand &cmd, const MythPianoEvent &event);
+  void EndSong(int kind);
+  void EndStationBlock();
+  void EndReply();
+  void Complete(int ok);
+  void LoginDone(int result);
+
+  std::string pianod_host;	/* these three under m_LoginLock */
+  int pianod_port;
+  std::string relay_path;
+  int pianod_fd;
+  MythPianoParser pianod_parser;
+  char pianod_buf[4096];
+  QSocketNotifier *m_Notifier;
+  std::string pianod_out;	/* flushed, but more than the socket would take */
+  QSocketNotifier *m_Writable;	/* on while pianod_out has something in it */
+
+  std::list<MythPianoCommand> pending;
+  MythPianoResponse           response;
+
+  /* what the reply at the head of the queue has given us so far */
+  int                 reply_lines;
+  int                 reply_bytes;
+  MythPianoSong       reply_song;
+  MythPianoPlaylist   reply_playlist;
+  MythPianoStringList reply_stations;
+  MythPianoStringList block_stations;	/* the 203 block at hand, until we know it is ours */
+  int                 block_pushed;	/* ... it has song fields: pianod pushed it */
+
+  /* see SetTimeouts() */
+  int connect_timeout;
+  int connect_stagger;
+  int reply_timeout;
+
+  /* a connection on its way: DialLive or DialSpare, the addresses to try
+   * and the attempts in the race */
+  QTimer                        *m_Stagger;
+  QTimer                        *m_ConnectDeadline;
+  int                            dialing;
+  int                            dial_lookup;
+  std::string                    dial_host;
+  int                            dial_port;
+  std::vector<QHostAddress>      dial_order;
+  size_t                         dial_next;
+  std::vector<QSocketNotifier *> dial_racing;
+
+  /* getting back in after pianod goes away */
+  MythPianoCommand m_Auth;
+  QTimer          *m_Retry;
+  QTimer          *m_Deadline;
+  int              retry_delay;
+  unsigned int     retry_seed;
+  int              reconnecting;
+  int              use_spare;
+  int              via_relay;	/* the live connection is mythpianorelay's */
+  std::string      trace_path;
+  MythPianoTraceWriter trace;
+  int              spare_fd;
+
+  MythPianoSong pending_song;
+
+  int login_pending;
+  int m_LoginResult;
+  QMutex m_LoginLock;
+  QWaitCondition m_LoginDone;
+};
+
+#endif /* MYTHPIANOSESSION_H */
@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <string.h>
+
+// MythPianod headers
+#include "mythpianosong.h"
+
+using namespace std;
+
+/* pianod's names for the fixed slots, in Field order */
+static const char *field_names[MythPianoSong::FieldCount] = {
+  "ID",
+  "Title",
+  "Artist",
+  "Album",
+  "Station",
+  "Rating",
+  "CoverArt",
+  "Genre",
+};
+
+static const string empty_field;
+
+void MythPianoSong::Clear()
+{
+  for(int x = 0; x < FieldCount; x++)
+	m_Fields[x].clear();
+  m_Extra.clear();
+}
+
+bool MythPianoSong::Empty() const
+{
+  for(int x = 0; x < FieldCount; x++)
+	if(!m_Fields[x].empty())
+		return false;
+  return m_Extra.empty();
+}
+
+/*
+ * Take one "Key: value" line of a track block. Returns false if the line
+ * does not look like a field.
+ */
+bool MythPianoSong::SetField(const char *line, int length)
+{
+  const char *sep = (const char *) memchr(line, ':', length);
+
+  if(!sep || sep + 1 >= line + length || sep[1] != ' ')
+	return false;
+
+  int keylen = sep - line;
+  const char *value = sep + 2;
+  int valuelen = line + length - value;
+
+  for(int x = 0; x < FieldCount; x++) {
+	if((int) strlen(field_names[x]) == keylen && !memcmp(field_names[x], line, keylen)) {
+		m_Fields[x].assign(value, valuelen);
+		return true;
+	}
+  }
+
+  for(size_t x = 0; x < m_Extra.size(); x++) {
+	if(m_Extra[x].first.compare(0, string::npos, line, keylen) == 0) {
+		m_Extra[x].second.assign(value, valuelen);
+		return true;
+	}
+  }
+
+  m_Extra.push_back(make_pair(string(line, keylen), string(value, valuelen)));
+  return true;
+}
+
+const string &MythPianoSong::Get(const string &key) const
+{
+  for(int x = 0; x < FieldCount; x++)
+	if(key == field_names[x])
+		return m_Fields[x];
+
+  for(size_t x = 0; x < m_Extra.size(); x++)
+	if(m_Extra[x].first == key)
+		return m_Extra[x].second;
+
+  return empty_field;
+}
+
+static uint64_t fnv1a(uint64_t hash, const string &s)
+{
+  for(size_t x = 0; x < s.size(); x++) {
+	hash ^= (unsigned char) s[x];
+	hash *= 1099511628211ULL;
+  }
+  /* keep "ab" + "c" apart from "a" + "bc" */
+  hash ^= 0xff;
+  hash *= 1099511628211ULL;
+  return hash;
+}
+
+/*
+ * A stable 64-bit name for the track: pianod's ID when it sends one,
+ * otherwise artist, album and title together, so two songs that merely
+ * share a title are not mistaken for each other.
+ */
+uint64_t MythPianoSong::Identity() const
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  if(!m_Fields[ID].empty())
+	return fnv1a(hash, m_Fields[ID]);
+
+  hash = fnv1a(hash, m_Fields[Artist]);
+  hash = fnv1a(hash, m_Fields[Album]);
+  return fnv1a(hash, m_Fields[Title]);
+}
+
+/* Bit(field) is set for every fixed field that differs from other. */
+unsigned int MythPianoSong::Diff(const MythPianoSong &other) const
+{
+  unsigned int mask = 0;
+
+  for(int x = 0; x < FieldCount; x++)
+	if(m_Fields[x] != other.m_Fields[x])
+		mask |= Bit((Field) x);
+  return mask;
+}
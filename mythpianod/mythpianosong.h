@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOSONG_H
+#define MYTHPIANOSONG_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+/*
+ * One track as pianod describes it in a 203 ... 204 block. The fields
+ * every screen looks at live in fixed slots indexed by Field; anything
+ * else pianod sends is kept, in arrival order, in a small side table.
+ */
+class MythPianoSong
+{
+ public:
+  enum Field {
+    ID,
+    Title,
+    Artist,
+    Album,
+    Station,
+    Rating,
+    CoverArt,
+    Genre,
+    FieldCount
+  };
+
+  /* Field masks for Diff() */
+  static unsigned int Bit(Field field) { return 1u << field; }
+  enum { AllFields = (1u << FieldCount) - 1 };
+
+  MythPianoSong() {}
+
+  void Clear();
+  bool Empty() const;
+  bool SetField(const char *line, int length);
+  void Set(Field field, const std::string &value) { m_Fields[field] = value; }
+
+  const std::string &Get(Field field) const { return m_Fields[field]; }
+  const std::string &Get(const std::string &key) const;
+
+  uint64_t     Identity() const;
+  unsigned int Diff(const MythPianoSong &other) const;
+
+ private:
+  std::string m_Fields[FieldCount];
+  std::vector<std::pair<std::string, std::string> > m_Extra;
+};
+
+typedef std::vector<MythPianoSong> MythPianoPlaylist;
+
+#endif /* MYTHPIANOSONG_H */
@@ -0,0 +1,195 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QCryptographicHash>
+
+// MythTV headers
+#include "mythcontext.h"
+#include "mythdirs.h"
+
+// MythPianod headers
+#include "mythpianostations.h"
+
+MythPianoStationList::MythPianoStationList()
+  : m_Version(0)
+{
+}
+
+/* One cache file per server and pianod user. */
+void MythPianoStationList::SetKey(const QString &server, const QString &user)
+{
+  QString dir = GetConfDir() + "/MythPianod/stations";
+  QByteArray key = QCryptographicHash::hash((server + "\n" + user).toUtf8(),
+					    QCryptographicHash::Sha1).toHex();
+
+  QDir().mkpath(dir);
+  m_File = dir + "/" + QString(key);
+}
+
+void MythPianoStationList::Clear()
+{
+  m_Names.clear();
+  m_Version = 0;
+  Index();
+}
+
+int MythPianoStationList::Find(const std::string &name) const
+{
+  return Find(QString::fromUtf8(name.c_str()));
+}
+
+int MythPianoStationList::Find(const QString &name) const
+{
+  return m_ByName.value(name, -1);
+}
+
+/*
+ * Stations with a word starting with 'prefix', in list order. An empty
+ * prefix matches everything.
+ */
+void MythPianoStationList::Match(const QString &prefix, std::vector<int> *found) const
+{
+  found->clear();
+
+  if (prefix.isEmpty()) {
+    for (int x = 0; x < (int) m_Names.size(); x++)
+      found->push_back(x);
+    return;
+  }
+
+  Word key;
+  key.word = prefix.toLower();
+  key.station = 0;
+
+  std::vector<Word>::const_iterator it =
+    std::lower_bound(m_Words.begin(), m_Words.end(), key);
+  for (; it != m_Words.end() && it->word.startsWith(key.word); ++it)
+    found->push_back(it->station);
+
+  // a name with the word twice shows up twice
+  std::sort(found->begin(), found->end());
+  found->erase(std::unique(found->begin(), found->end()), found->end());
+}
+
+void MythPianoStationList::Index()
+{
+  m_ByName.clear();
+  m_Words.clear();
+
+  for (int x = 0; x < (int) m_Names.size(); x++) {
+    QString name = QString::fromUtf8(m_Names[x].c_str());
+    QString lower = name.toLower();
+
+    m_ByName.insert(name, x);
+    for (int y = 0; y < lower.size(); y++) {
+      if (!lower.at(y).isLetterOrNumber() || (y && lower.at(y - 1).isLetterOrNumber()))
+        continue;
+      Word word;
+      word.word = lower.mid(y);
+      word.station = x;
+      m_Words.push_back(word);
+    }
+  }
+  std::sort(m_Words.begin(), m_Words.end());
+}
+
+/* FNV-1a over the names, each one terminated by a newline. */
+unsigned long long MythPianoStationList::Hash(const std::vector<std::string> &names)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+
+  for (size_t x = 0; x < names.size(); x++) {
+    const std::string &name = names[x];
+    for (size_t y = 0; y <= name.size(); y++) {
+      hash ^= (unsigned char) (y < name.size() ? name[y] : '\n');
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+/* Pick up what the last run saw. False if there is nothing usable. */
+bool MythPianoStationList::Load()
+{
+  QFile file(m_File);
+
+  Clear();
+  if (m_File.isEmpty() || !file.open(QIODevice::ReadOnly))
+    return false;
+
+  while (!file.atEnd()) {
+    QByteArray line = file.readLine();
+    if (line.endsWith('\n'))
+      line.chop(1);
+    if (!line.isEmpty())
+      m_Names.push_back(std::string(line.constData(), line.size()));
+  }
+
+  m_Version = Hash(m_Names);
+  Index();
+  return !m_Names.empty();
+}
+
+/*
+ * Take the list pianod just sent. Returns true, and rewrites the cache,
+ * only if it differs from what we had.
+ */
+bool MythPianoStationList::Update(const std::vector<std::string> &names)
+{
+  unsigned long long version = Hash(names);
+
+  if (version == m_Version && names.size() == m_Names.size())
+    return false;
+
+  m_Names = names;
+  m_Version = version;
+  Index();
+  Save();
+  return true;
+}
+
+bool MythPianoStationList::Save() const
+{
+  QString tmp = m_File + ".tmp";
+  QFile file(tmp);
+
+  if (m_File.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot write station cache " + tmp);
+    return false;
+  }
+
+  for (size_t x = 0; x < m_Names.size(); x++) {
+    file.write(m_Names[x].data(), m_Names[x].size());
+    file.write("\n", 1);
+  }
+  file.close();
+
+  // never leave a half written list where the next run would read it
+  QFile::remove(m_File);
+  return QFile::rename(tmp, m_File);
+}
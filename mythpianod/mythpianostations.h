@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOSTATIONS_H
+#define MYTHPIANOSTATIONS_H
+
+#include <string>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+/*
+ * The station list of one pianod account, kept on disk between runs so
+ * the station picker can show it before pianod has said a word. The
+ * version is a hash of the names: pianod has nothing like an ETag, so
+ * a refresh that hashes the same is a refresh that changed nothing.
+ *
+ * Lookups go through an index rebuilt whenever the names change: a hash
+ * for exact names and a sorted table of every word of every name for
+ * type-ahead, so "jaz" finds "Smooth Jazz Radio" with a binary search.
+ */
+class MythPianoStationList
+{
+ public:
+  MythPianoStationList();
+
+  void SetKey(const QString &server, const QString &user);
+  bool Load();
+  bool Update(const std::vector<std::string> &names);
+  void Clear();
+
+  int                Size() const { return m_Names.size(); }
+  const std::string &Name(int idx) const { return m_Names[idx]; }
+  int                Find(const std::string &name) const;
+  int                Find(const QString &name) const;
+  void               Match(const QString &prefix, std::vector<int> *found) const;
+
+  const std::vector<std::string> &Names() const { return m_Names; }
+  unsigned long long Version() const { return m_Version; }
+
+ private:
+  static unsigned long long Hash(const std::vector<std::string> &names);
+  bool Save() const;
+  void Index();
+
+  struct Word {
+    QString word;   // lower case, from the start of a word to the end of the name
+    int     station;
+    bool operator<(const Word &other) const { return word < other.word; }
+  };
+
+  QString                  m_File;
+  std::vector<std::string> m_Names;
+  unsigned long long       m_Version;
+  QHash<QString, int>      m_ByName;
+  std::vector<Word>        m_Words;
+};
+
+#endif /* MYTHPIANOSTATIONS_H */
@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <time.h>
+
+#include <QFile>
+
+// MythTV headers
+#include "mythcontext.h"
+
+// MythPianod headers
+#include "mythpianostats.h"
+
+static MythPianoStats stats;
+
+MythPianoStats *GetMythPianoStats()
+{
+  return &stats;
+}
+
+void MythPianoHistogram::Clear()
+{
+  for (int x = 0; x < Buckets; x++)
+    m_Counts[x] = 0;
+  m_Count = 0;
+  m_Max = 0;
+}
+
+/* 0..3 get a bucket each; above that the top bit picks four, the next two pick one */
+int MythPianoHistogram::Bucket(uint32_t usec)
+{
+  int msb = 0;
+
+  if (usec < 4)
+    return usec;
+  while (usec >> (msb + 1))
+    msb++;
+  return msb * 4 + ((usec >> (msb - 2)) & 3);
+}
+
+/* Largest value that lands in 'bucket'. */
+uint32_t MythPianoHistogram::Top(int bucket)
+{
+  if (bucket < 4)
+    return bucket;
+
+  int msb = bucket / 4;
+  uint64_t top = ((uint64_t) (5 + bucket % 4) << (msb - 2)) - 1;
+  return top > 0xffffffffULL ? 0xffffffffU : (uint32_t) top;
+}
+
+void MythPianoHistogram::Add(uint32_t usec)
+{
+  m_Counts[Bucket(usec)]++;
+  m_Count++;
+  if (usec > m_Max)
+    m_Max = usec;
+}
+
+uint32_t MythPianoHistogram::Percentile(int percent) const
+{
+  uint64_t want = ((uint64_t) m_Count * percent + 99) / 100;
+  uint64_t seen = 0;
+
+  if (!m_Count)
+    return 0;
+
+  for (int x = 0; x < Buckets; x++) {
+    seen += m_Counts[x];
+    if (seen >= want)
+      return Top(x) < m_Max ? Top(x) : m_Max;
+  }
+  return m_Max;
+}
+
+MythPianoStats::MythPianoStats()
+  : m_Started(Now()),
+    m_Disconnects(0),
+    m_Reconnects(0)
+{
+  for (int x = 0; x < Kinds; x++) {
+    m_Kinds[x].errors = 0;
+    m_Kinds[x].bytes = 0;
+    m_Kinds[x].lines = 0;
+  }
+}
+
+uint64_t MythPianoStats::Now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* I/O thread: a reply to a 'kind' command just ended. */
+void MythPianoStats::Command(int kind, int ok, uint64_t usec, int bytes, int lines)
+{
+  if (kind < 0 || kind >= Kinds)
+    return;
+
+  QMutexLocker locker(&m_Lock);
+  Kind &k = m_Kinds[kind];
+
+  k.latency.Add(usec > 0xffffffffULL ? 0xffffffffU : (uint32_t) usec);
+  if (!ok)
+    k.errors++;
+  k.bytes += bytes;
+  k.lines += lines;
+}
+
+void MythPianoStats::Disconnected()
+{
+  QMutexLocker locker(&m_Lock);
+  m_Disconnects++;
+}
+
+void MythPianoStats::Reconnected()
+{
+  QMutexLocker locker(&m_Lock);
+  m_Reconnects++;
+}
+
+/* GUI thread: time spent putting new state into widgets. */
+void MythPianoStats::UiTime(int what, uint64_t usec)
+{
+  if (what < 0 || what >= UiKinds)
+    return;
+
+  QMutexLocker locker(&m_Lock);
+  m_Ui[what].Add(usec > 0xffffffffULL ? 0xffffffffU : (uint32_t) usec);
+}
+
+/* GUI thread: how long a track change took, one way or another. */
+void MythPianoStats::GapTime(int what, uint64_t usec)
+{
+  if (what < 0 || what >= Gaps)
+    return;
+
+  QMutexLocker locker(&m_Lock);
+  m_Gaps[what].Add(usec > 0xffffffffULL ? 0xffffffffU : (uint32_t) usec);
+}
+
+static QString Millis(uint32_t usec)
+{
+  return QString::number(usec / 1000.0, 'f', 1) + "ms";
+}
+
+static QString Line(const char *name, const MythPianoHistogram &h)
+{
+  return QString("%1 n=%2 p50=%3 p95=%4 p99=%5 max=%6")
+    .arg(QString(name), -10)
+    .arg(h.Count())
+    .arg(Millis(h.Percentile(50)))
+    .arg(Millis(h.Percentile(95)))
+    .arg(Millis(h.Percentile(99)))
+    .arg(Millis(h.Max()));
+}
+
+/* One line per thing that has happened at least once, totals since start. */
+QStringList MythPianoStats::Report()
+{
+  static const char *kinds[] = {
+    "plain", "welcome", "login", "status", "stations", "queue", "rate", "volume", "shutdown"
+  };
+  static const char *uis[] = { "refresh", "stations" };
+  static const char *gaps[] = { "intertrack", "shown" };
+  QMutexLocker locker(&m_Lock);
+  QStringList report;
+
+  report << QString("uptime %1s disconnects=%2 reconnects=%3")
+    .arg((int) ((Now() - m_Started) / 1000000))
+    .arg(m_Disconnects).arg(m_Reconnects);
+
+  for (int x = 0; x < Kinds; x++) {
+    const Kind &k = m_Kinds[x];
+    uint32_t count = k.latency.Count();
+    if (!count)
+      continue;
+
+    const char *name = x < (int) (sizeof(kinds) / sizeof(kinds[0])) ? kinds[x] : "other";
+    report << "pianod " + Line(name, k.latency) +
+      QString(" errors=%1 bytes/reply=%2 lines/reply=%3")
+      .arg(k.errors)
+      .arg((qulonglong) (k.bytes / count))
+      .arg((qulonglong) (k.lines / count));
+  }
+
+  for (int x = 0; x < UiKinds; x++)
+    if (m_Ui[x].Count())
+      report << "ui " + Line(uis[x], m_Ui[x]);
+
+  for (int x = 0; x < Gaps; x++)
+    if (m_Gaps[x].Count())
+      report << "gap " + Line(gaps[x], m_Gaps[x]);
+
+  return report;
+}
+
+bool MythPianoStats::Dump(const QString &path)
+{
+  QStringList report = Report();
+  QFile file(path);
+
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    LOG(VB_GENERAL, LOG_ERR, "MythPianod: cannot write statistics to " + path);
+    return false;
+  }
+  file.write(report.join("\n").toUtf8());
+  file.write("\n", 1);
+  return true;
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOSTATS_H
+#define MYTHPIANOSTATS_H
+
+#include <stdint.h>
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Log-scaled histogram of microsecond timings: four buckets per power of
+ * two, so any percentile read back is within 25% of the real value and
+ * the whole thing is a fixed 128 counters.
+ */
+class MythPianoHistogram
+{
+ public:
+  MythPianoHistogram() { Clear(); }
+
+  void     Clear();
+  void     Add(uint32_t usec);
+  uint32_t Percentile(int percent) const;
+  uint32_t Count() const { return m_Count; }
+  uint32_t Max() const { return m_Max; }
+
+ private:
+  enum { Buckets = 128 };
+  static int      Bucket(uint32_t usec);
+  static uint32_t Top(int bucket);
+
+  uint32_t m_Counts[Buckets];
+  uint32_t m_Count;
+  uint32_t m_Max;
+};
+
+/*
+ * What the pianod client has been up to: how long each kind of command
+ * takes from write to last reply line, how big the replies are, how often
+ * the connection drops, how long the player screen takes to update and
+ * how long the silence between tracks lasts.
+ * Written from both the I/O and GUI threads.
+ */
+class MythPianoStats
+{
+ public:
+  enum { Kinds = 16 };
+  enum Ui { Refresh, StationList, UiKinds };
+  /* from pianod's 104 to its 101, and to the new track being on screen */
+  enum Gap { Intertrack, TrackShown, Gaps };
+
+  MythPianoStats();
+
+  static uint64_t Now();
+
+  void Command(int kind, int ok, uint64_t usec, int bytes, int lines);
+  void Disconnected();
+  void Reconnected();
+  void UiTime(int what, uint64_t usec);
+  void GapTime(int what, uint64_t usec);
+
+  QStringList Report();
+  bool        Dump(const QString &path);
+
+ private:
+  struct Kind {
+    MythPianoHistogram latency;
+    uint32_t           errors;
+    uint64_t           bytes;
+    uint64_t           lines;
+  };
+
+  QMutex             m_Lock;
+  uint64_t           m_Started;
+  Kind               m_Kinds[Kinds];
+  MythPianoHistogram m_Ui[UiKinds];
+  MythPianoHistogram m_Gaps[Gaps];
+  uint32_t           m_Disconnects;
+  uint32_t           m_Reconnects;
+};
+
+MythPianoStats *GetMythPianoStats();
+
+#endif /* MYTHPIANOSTATS_H */
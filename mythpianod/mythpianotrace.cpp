@@ -0,0 +1,207 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// MythPianod headers
+#include "mythpianotrace.h"
+
+static const char magic[8] = { 'M', 'P', 'T', 'R', 'A', 'C', 'E', '1' };
+
+static uint64_t now_usec()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void put_varint(FILE *file, uint64_t value)
+{
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    putc(byte, file);
+  } while (value);
+}
+
+MythPianoTraceWriter::MythPianoTraceWriter()
+  : m_File(NULL),
+    m_Last(0)
+{
+}
+
+MythPianoTraceWriter::~MythPianoTraceWriter()
+{
+  Close();
+}
+
+int MythPianoTraceWriter::Open(const std::string &path)
+{
+  Close();
+
+  /* whatever the umask, only the user gets to read what they listened to */
+  int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+
+  if (fd < 0 || fchmod(fd, 0600) < 0 || !(m_File = fdopen(fd, "wb"))) {
+    perror("could not open pianod trace");
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  fwrite(magic, 1, sizeof(magic), m_File);
+  m_Last = now_usec();
+  return 0;
+}
+
+void MythPianoTraceWriter::Close()
+{
+  if (m_File) {
+    fclose(m_File);
+    m_File = NULL;
+  }
+}
+
+/*
+ * The "user" command with its name and password taken out, every line of
+ * it; everything else as is. Playback only needs to know a login went by.
+ */
+std::string MythPianoTraceRedact(const char *data, size_t len)
+{
+  std::string out;
+  size_t start = 0;
+
+  while (start < len) {
+    const char *eol = (const char *) memchr(data + start, '\n', len - start);
+    size_t end = eol ? eol - data + 1 : len;
+
+    if (end - start >= 5 && !memcmp(data + start, "user ", 5))
+      out += eol ? "user * *\n" : "user * *";
+    else
+      out.append(data + start, end - start);
+    start = end;
+  }
+  return out;
+}
+
+void MythPianoTraceWriter::Record(int type, const char *data, size_t len)
+{
+  if (!m_File)
+    return;
+
+  std::string redacted;
+  if (type == MythPianoTraceRecord::Wrote) {
+    redacted = MythPianoTraceRedact(data, len);
+    data = redacted.data();
+    len = redacted.size();
+  }
+
+  uint64_t now = now_usec();
+
+  putc(type, m_File);
+  put_varint(m_File, now - m_Last);
+  put_varint(m_File, len);
+  fwrite(data, 1, len, m_File);
+  m_Last = now;
+}
+
+/* stdio buffers the rest; a connection ending is a good time to let go of it */
+void MythPianoTraceWriter::Flush()
+{
+  if (m_File)
+    fflush(m_File);
+}
+
+MythPianoTraceReader::MythPianoTraceReader()
+  : m_File(NULL),
+    m_Time(0)
+{
+}
+
+MythPianoTraceReader::~MythPianoTraceReader()
+{
+  if (m_File)
+    fclose(m_File);
+}
+
+int MythPianoTraceReader::Open(const std::string &path)
+{
+  char header[sizeof(magic)];
+
+  if (!(m_File = fopen(path.c_str(), "rb"))) {
+    perror("could not open pianod trace");
+    return -1;
+  }
+
+  if (fread(header, 1, sizeof(header), m_File) != sizeof(header) ||
+      memcmp(header, magic, sizeof(magic))) {
+    fprintf(stderr, "%s is not a pianod trace\n", path.c_str());
+    fclose(m_File);
+    m_File = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+bool MythPianoTraceReader::Varint(uint64_t *value)
+{
+  int shift = 0;
+  int byte;
+
+  *value = 0;
+  do {
+    if ((byte = getc(m_File)) == EOF || shift > 63)
+      return false;
+    *value |= (uint64_t) (byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return true;
+}
+
+/* False at the end, or where a trace cut short by a crash stops making sense. */
+bool MythPianoTraceReader::Next(MythPianoTraceRecord *record)
+{
+  uint64_t delta, len;
+  int type;
+
+  if (!m_File || (type = getc(m_File)) == EOF)
+    return false;
+  if (!Varint(&delta) || !Varint(&len) || len > (1 << 24))
+    return false;
+
+  record->type = type;
+  record->usec = (m_Time += delta);
+  record->data.resize(len);
+  if (len && fread(&record->data[0], 1, len, m_File) != len)
+    return false;
+  return true;
+}
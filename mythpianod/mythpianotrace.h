@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOTRACE_H
+#define MYTHPIANOTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+
+/*
+ * A pianod session on disk, byte for byte and with timing, so a stall
+ * seen once can be played back as often as it takes.
+ *
+ * The file is "MPTRACE1" followed by records of
+ *
+ *     type      1 byte: Connected, Wrote, Read or Disconnected
+ *     delta     varint, microseconds since the previous record
+ *     length    varint
+ *     payload   'length' bytes
+ *
+ * Wrote and Read carry exactly what went to and came from the socket,
+ * except that the name and password of the "user" command are replaced
+ * (see MythPianoTraceRedact); the file is readable by its owner only.
+ * Connected carries the server, Disconnected the reason. Disconnected
+ * is only for pianod going away; a trace that stops without one is a
+ * connection the plugin itself closed.
+ */
+struct MythPianoTraceRecord
+{
+  enum Type {
+    Connected    = 'C',
+    Wrote        = 'W',
+    Read         = 'R',
+    Disconnected = 'D'
+  };
+
+  int         type;
+  uint64_t    usec;   // since the trace started
+  std::string data;
+};
+
+std::string MythPianoTraceRedact(const char *data, size_t len);
+
+/* Written from the I/O thread only; nothing here locks. */
+class MythPianoTraceWriter
+{
+ public:
+  MythPianoTraceWriter();
+  ~MythPianoTraceWriter();
+
+  int  Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return m_File != NULL; }
+
+  void Record(int type, const char *data, size_t len);
+  void Record(int type, const std::string &data) { Record(type, data.data(), data.size()); }
+  void Flush();
+
+ private:
+  FILE     *m_File;
+  uint64_t  m_Last;
+};
+
+class MythPianoTraceReader
+{
+ public:
+  MythPianoTraceReader();
+  ~MythPianoTraceReader();
+
+  int  Open(const std::string &path);
+  bool Next(MythPianoTraceRecord *record);
+
+ private:
+  bool Varint(uint64_t *value);
+
+  FILE     *m_File;
+  uint64_t  m_Time;
+};
+
+#endif /* MYTHPIANOTRACE_H */
@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// POSIX headers
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <QThread>
+
+// MythPianod headers
+#include "mythpianoworker.h"
+
+MythPianoWorker::MythPianoWorker(int zones)
+  : QObject(NULL),
+    m_WakeNotifier(NULL)
+{
+  for(int x = 0; x < zones; x++)
+	m_Sessions.push_back(new MythPianoSession(this));
+
+  if(pipe(m_WakeFds) < 0) {
+	perror("could not create pianod wakeup pipe");
+	m_WakeFds[0] = m_WakeFds[1] = -1;
+	return;
+  }
+  fcntl(m_WakeFds[0], F_SETFL, fcntl(m_WakeFds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(m_WakeFds[1], F_SETFL, fcntl(m_WakeFds[1], F_GETFL) | O_NONBLOCK);
+}
+
+MythPianoWorker::~MythPianoWorker()
+{
+  if(m_WakeFds[0] != -1) {
+	close(m_WakeFds[0]);
+	close(m_WakeFds[1]);
+  }
+}
+
+/* Runs in the I/O thread once it has started. */
+void MythPianoWorker::Start(void)
+{
+  m_WakeNotifier = new QSocketNotifier(m_WakeFds[0], QSocketNotifier::Read, this);
+  connect(m_WakeNotifier, SIGNAL(activated(int)), this, SLOT(wakeup()));
+
+  /* anything posted before we got here */
+  wakeup();
+}
+
+/*
+ * Queue a command for the I/O thread. Commands posted with wake == 0 sit
+ * in the ring until the next wakeup, so a batch of them gets written to
+ * pianod together.
+ */
+bool MythPianoWorker::Post(const MythPianoCommand &cmd, int wake)
+{
+  if(m_WakeFds[1] == -1 || !m_Queue.Push(cmd))
+	return false;
+
+  if(wake)
+	Wake();
+  return true;
+}
+
+bool MythPianoWorker::Wake()
+{
+  char poke = 0;
+
+  /* A full pipe already means a wakeup is on its way. */
+  if(m_WakeFds[1] == -1 || (write(m_WakeFds[1], &poke, 1) < 0 && errno != EAGAIN)) {
+	perror("could not wake pianod thread");
+	return false;
+  }
+  return true;
+}
+
+/*
+ * Tell the I/O thread to hang up and quit. That must get through even
+ * when the ring is full or the pipe is broken, so failing the usual way
+ * we raise a flag the thread checks first thing and knock on its event
+ * loop directly.
+ */
+void MythPianoWorker::Stop(const std::string &msg)
+{
+  if(Post(MythPianoCommand(MythPianoCommand::Shutdown, 0, msg), 0) && Wake())
+	return;
+
+  m_StopText = msg;
+  m_Stopping.fetchAndStoreRelease(1);
+  QMetaObject::invokeMethod(this, "wakeup", Qt::QueuedConnection);
+}
+
+void MythPianoWorker::ShutdownAll(const std::string &msg)
+{
+  if(!m_WakeNotifier)
+	return;
+
+  for(size_t x = 0; x < m_Sessions.size(); x++)
+	m_Sessions[x]->Shutdown(msg);
+  m_WakeNotifier->setEnabled(false);
+  m_WakeNotifier->deleteLater();
+  m_WakeNotifier = NULL;
+  thread()->quit();
+}
+
+void MythPianoWorker::wakeup(void)
+{
+  char buf[64];
+  MythPianoCommand cmd;
+
+  while(m_WakeFds[0] != -1 && read(m_WakeFds[0], buf, sizeof(buf)) > 0)
+	;
+
+  if(m_Stopping.fetchAndAddAcquire(0)) {
+	ShutdownAll(m_StopText);
+	return;
+  }
+
+  while(m_Queue.Pop(cmd)) {
+	if(cmd.zone < 0 || cmd.zone >= (int) m_Sessions.size())
+		continue;
+
+	switch(cmd.kind) {
+	case MythPianoCommand::Login:
+		m_Sessions[cmd.zone]->Login(cmd);
+		break;
+	case MythPianoCommand::Shutdown:
+		ShutdownAll(cmd.text);
+		return;
+	default:
+		m_Sessions[cmd.zone]->Submit(cmd);
+		break;
+	}
+  }
+
+  for(size_t x = 0; x < m_Sessions.size(); x++)
+	m_Sessions[x]->Flush();
+}
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOWORKER_H
+#define MYTHPIANOWORKER_H
+
+#include <string>
+#include <vector>
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QSocketNotifier>
+
+#include "mythpianoqueue.h"
+#include "mythpianosession.h"
+
+/*
+ * Front door of the pianod I/O thread. The GUI thread Post()s commands
+ * onto a lock-free ring and pokes a pipe; the I/O thread wakes up on the
+ * pipe, drains the ring and hands the commands to the session of the
+ * zone they are for. All zones share the one thread: each session is
+ * just another socket notifier in its event loop.
+ */
+class MythPianoWorker : public QObject
+{
+  Q_OBJECT
+
+ public:
+  MythPianoWorker(int zones = 1);
+  ~MythPianoWorker();
+
+  /* GUI thread only */
+  bool Post(const MythPianoCommand &cmd, int wake = 1);
+  bool Wake();
+  void Stop(const std::string &msg);
+
+  MythPianoSession *Session(int zone = 0) { return m_Sessions[zone]; }
+  int               Zones() const { return m_Sessions.size(); }
+
+ public slots:
+  void Start(void);
+
+ private slots:
+  void wakeup(void);
+
+ private:
+  void ShutdownAll(const std::string &msg);
+
+  MythPianoQueue<MythPianoCommand, 64> m_Queue;
+  int               m_WakeFds[2];
+  QSocketNotifier  *m_WakeNotifier;
+  QAtomicInt        m_Stopping;
+  std::string       m_StopText;	/* written before m_Stopping is raised */
+  std::vector<MythPianoSession *> m_Sessions;
+};
+
+#endif /* MYTHPIANOWORKER_H */
@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <QStringList>
+
+// MythTV headers
+#include "mythcontext.h"
+
+// MythPianod headers
+#include "mythpianozone.h"
+
+MythPianoZone::MythPianoZone(const QString &name, const QString &host, int port,
+			     QObject *parent)
+  : QObject(parent),
+    m_Name(name),
+    m_Host(host),
+    m_Port(port),
+    m_Connected(0),
+    m_PlayState(0)
+{
+}
+
+/* One line for the zone picker: where it is and what it is playing. */
+QString MythPianoZone::Summary() const
+{
+  QString state;
+
+  if (!m_Connected)
+    return m_Name + ": not connected";
+
+  switch (m_PlayState) {
+  case 101: state = "playing"; break;
+  case 102: state = "paused"; break;
+  case 103: state = "stopped"; break;
+  case 104: state = "between tracks"; break;
+  default:  state = "idle"; break;
+  }
+
+  if (m_Song.Empty() || m_PlayState == 103)
+    return QString("%1: %2").arg(m_Name).arg(state);
+
+  return QString("%1: %2 - %3 (%4)").arg(m_Name)
+    .arg(m_Song.Get(MythPianoSong::Title).c_str())
+    .arg(m_Song.Get(MythPianoSong::Artist).c_str())
+    .arg(state);
+}
+
+void MythPianoZone::zone_playback(int code, QString value)
+{
+  (void) value;
+
+  if (code == m_PlayState)
+    return;
+  m_PlayState = code;
+  emit Changed();
+}
+
+void MythPianoZone::zone_song(MythPianoSong song)
+{
+  if (song.Identity() == m_Song.Identity())
+    return;
+  m_Song = song;
+  emit Changed();
+}
+
+/* A station list only ever arrives once we are logged in. */
+void MythPianoZone::zone_stations(MythPianoStringList stations)
+{
+  (void) stations;
+
+  if (m_Connected)
+    return;
+  m_Connected = 1;
+  emit Changed();
+}
+
+void MythPianoZone::zone_disconnected(QString reason)
+{
+  (void) reason;
+
+  m_Connected = 0;
+  m_PlayState = 0;
+  emit Changed();
+}
+
+/* "host", "host:port", or "[v6 address]:port" */
+bool ParseMythPianoServer(const QString &server, QString *host, int *port)
+{
+  QString s = server.trimmed();
+  int colon = s.lastIndexOf(':');
+
+  *host = s;
+  *port = 4445;
+
+  if (s.startsWith('[')) {
+    int close = s.indexOf(']');
+    *host = s.mid(1, close - 1);
+    if (close > 0 && colon > close)
+      *port = s.mid(colon + 1).toInt();
+  } else if (colon > 0 && s.indexOf(':') == colon) {
+    *host = s.left(colon);
+    *port = s.mid(colon + 1).toInt();
+  }
+
+  return !host->isEmpty() && *port > 0 && *port <= 65535;
+}
+
+/*
+ * Zone 0 is the server from the settings screen. Any others come from
+ * pandora-zones, a comma separated list of name=host[:port] entries.
+ */
+MythPianoZoneList LoadMythPianoZones(QObject *parent)
+{
+  MythPianoZoneList zones;
+  QStringList extra = gCoreContext->GetSetting("pandora-zones").split(',', QString::SkipEmptyParts);
+
+  zones.push_back(new MythPianoZone("Main",
+				    gCoreContext->GetSetting("pandora-host", "127.0.0.1"),
+				    gCoreContext->GetNumSetting("pandora-port", 4445),
+				    parent));
+
+  for (int x = 0; x < extra.size(); x++) {
+    QString entry = extra[x];
+    int equals = entry.indexOf('=');
+    QString host;
+    int port;
+
+    if (equals <= 0 || !ParseMythPianoServer(entry.mid(equals + 1), &host, &port)) {
+      LOG(VB_GENERAL, LOG_ERR, "MythPianod: ignoring bad zone " + entry);
+      continue;
+    }
+    zones.push_back(new MythPianoZone(entry.left(equals).trimmed(), host, port, parent));
+  }
+
+  return zones;
+}
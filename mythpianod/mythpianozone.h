@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOZONE_H
+#define MYTHPIANOZONE_H
+
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+#include "mythpianosession.h"
+
+/*
+ * What we know about one pianod server ("zone") without asking it: every
+ * zone's session pushes its playback notices and track changes to the
+ * GUI thread anyway, and this keeps the last of them for the zone picker.
+ * Lives in the GUI thread.
+ */
+class MythPianoZone : public QObject
+{
+  Q_OBJECT
+
+ public:
+  MythPianoZone(const QString &name, const QString &host, int port,
+		QObject *parent = NULL);
+
+  const QString       &Name() const { return m_Name; }
+  const QString       &Host() const { return m_Host; }
+  int                  Port() const { return m_Port; }
+  void                 SetServer(const QString &host, int port) { m_Host = host; m_Port = port; }
+  int                  Connected() const { return m_Connected; }
+  const MythPianoSong &Song() const { return m_Song; }
+  QString              Summary() const;
+
+ signals:
+  void Changed(void);
+
+ public slots:
+  void zone_playback(int code, QString value);
+  void zone_song(MythPianoSong song);
+  void zone_stations(MythPianoStringList stations);
+  void zone_disconnected(QString reason);
+
+ private:
+  QString       m_Name;
+  QString       m_Host;
+  int           m_Port;
+  int           m_Connected;
+  int           m_PlayState;
+  MythPianoSong m_Song;
+};
+
+typedef std::vector<MythPianoZone *> MythPianoZoneList;
+
+bool ParseMythPianoServer(const QString &server, QString *host, int *port);
+MythPianoZoneList LoadMythPianoZones(QObject *parent);
+
+#endif /* MYTHPIANOZONE_H */
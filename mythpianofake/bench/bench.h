@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef MYTHPIANOBENCH_H
+#define MYTHPIANOBENCH_H
+
+#include <QObject>
+#include <QString>
+
+// MythPianod headers
+#include "mythpianosession.h"
+#include "mythpianoworker.h"
+
+/*
+ * Drives a session the way the player screen does, round after round:
+ * status, queue, station list and a volume change, pipelined, the next
+ * round going out when the station list of the last one is in.
+ */
+class MythPianoBench : public QObject
+{
+  Q_OBJECT
+
+ public:
+  MythPianoBench(MythPianoWorker *worker, int rounds);
+
+  int    Rounds() const { return m_Done; }
+  double Seconds() const;
+
+ public slots:
+  void bench_stations(MythPianoStringList stations);
+  void bench_disconnected(QString reason);
+
+ private:
+  void Start();
+  void Round();
+
+  MythPianoWorker *m_Worker;
+  int              m_Rounds;
+  int              m_Done;
+  uint64_t         m_Started;  /* 0 until the login's station list is in */
+};
+
+#endif /* MYTHPIANOBENCH_H */
@@ -0,0 +1,31 @@
+include ( ../../../mythconfig.mak )
+include ( ../../../settings.pro )
+include ( ../../../programs-libs.pro )
+
+# The plugin's pianod client on its own, against mythpianofake or a real
+# pianod, printing what each kind of command costs. Not built or
+# installed with the rest; run qmake and make here when you want it.
+
+QT += network
+
+PREFIX=/usr/local
+
+TEMPLATE = app
+CONFIG += console thread
+TARGET = mythpianobench
+
+INCLUDEPATH += ../../mythpianod
+INCLUDEPATH += $${PREFIX}/include/mythtv
+INCLUDEPATH += $${PREFIX}/include/mythtv/libmyth
+
+# Input
+HEADERS += bench.h
+HEADERS += ../../mythpianod/mythpianosession.h ../../mythpianod/mythpianoworker.h
+HEADERS += ../../mythpianod/mythpianoqueue.h ../../mythpianod/mythpianoparser.h
+HEADERS += ../../mythpianod/mythpianoresponse.h ../../mythpianod/mythpianosong.h
+HEADERS += ../../mythpianod/mythpianostats.h ../../mythpianod/mythpianotrace.h
+SOURCES += main.cpp
+SOURCES += ../../mythpianod/mythpianosession.cpp ../../mythpianod/mythpianoworker.cpp
+SOURCES += ../../mythpianod/mythpianoparser.cpp ../../mythpianod/mythpianoresponse.cpp
+SOURCES += ../../mythpianod/mythpianosong.cpp ../../mythpianod/mythpianostats.cpp
+SOURCES += ../../mythpianod/mythpianotrace.cpp
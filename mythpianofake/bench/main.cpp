@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * mythpianobench: the plugin's pianod client, without the plugin.
+ *
+ * Runs MythPianoSession in its own I/O thread behind MythPianoWorker,
+ * exactly as the plugin does, against a pianod or (more usefully) a
+ * mythpianofake set up to be slow, flaky or huge. It logs in, starts a
+ * station and then does -n rounds of what the player screen asks for,
+ * then prints the same statistics the plugin logs: latency percentiles
+ * and reply sizes per kind of command, disconnects and reconnects.
+ *
+ * usage: mythpianobench [-n rounds] [-t seconds] [-u user] [-p password]
+ *                       [host [port]]
+ */
+
+// POSIX headers
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+
+// MythPianod headers
+#include "bench.h"
+#include "mythpianostats.h"
+
+using namespace std;
+
+MythPianoBench::MythPianoBench(MythPianoWorker *worker, int rounds)
+  : QObject(NULL),
+    m_Worker(worker),
+    m_Rounds(rounds),
+    m_Done(0),
+    m_Started(0)
+{
+}
+
+/* Logged in and the login's station list is in: put something on, then start the rounds. */
+void MythPianoBench::Start()
+{
+  m_Started = MythPianoStats::Now();
+  m_Worker->Post(MythPianoCommand(MythPianoCommand::Plain, 200, "select station \"Station 0\"\n"), 0);
+  m_Worker->Post(MythPianoCommand(MythPianoCommand::Plain, 200, "play\n"), 0);
+  Round();
+}
+
+/* One screenful: posted together, written to pianod together. */
+void MythPianoBench::Round()
+{
+  m_Worker->Post(MythPianoCommand(MythPianoCommand::Status, 204, "status\n"), 0);
+  m_Worker->Post(MythPianoCommand(MythPianoCommand::Queue, 204, "queue\n"), 0);
+  m_Worker->Post(MythPianoCommand(MythPianoCommand::Volume, 200, "volume 0\n"), 0);
+  if(!m_Worker->Post(MythPianoCommand(MythPianoCommand::Stations, 204, "stations list\n")))
+	fprintf(stderr, "pianod thread is not keeping up\n");
+}
+
+double MythPianoBench::Seconds() const
+{
+  return m_Started ? (MythPianoStats::Now() - m_Started) / 1e6 : 0;
+}
+
+/* The last reply of a round (or of a reconnect) is in. */
+void MythPianoBench::bench_stations(MythPianoStringList stations)
+{
+  /* the first list is the one Login() asks for; it is not a round */
+  if(!m_Started) {
+	Start();
+	return;
+  }
+  if(++m_Done >= m_Rounds) {
+	QCoreApplication::quit();
+	return;
+  }
+  Round();
+}
+
+void MythPianoBench::bench_disconnected(QString reason)
+{
+  fprintf(stderr, "lost pianod: %s", reason.toUtf8().data());
+}
+
+int main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+  const char *host = "127.0.0.1";
+  int port = 4445;
+  const char *user = "bench";
+  const char *password = "bench";
+  int rounds = 1000;
+  int seconds = 60;
+  int opt;
+
+  while((opt = getopt(argc, argv, "n:t:u:p:")) != -1) {
+	switch(opt) {
+	case 'n': rounds = atoi(optarg); break;
+	case 't': seconds = atoi(optarg); break;
+	case 'u': user = optarg; break;
+	case 'p': password = optarg; break;
+	default:
+		fprintf(stderr, "usage: %s [-n rounds] [-t seconds] [-u user] [-p password]\n"
+			"       [host [port]]\n", argv[0]);
+		return 1;
+	}
+  }
+  if(optind < argc)
+	host = argv[optind++];
+  if(optind < argc)
+	port = atoi(argv[optind++]);
+
+  qRegisterMetaType<MythPianoSong>("MythPianoSong");
+  qRegisterMetaType<MythPianoStringList>("MythPianoStringList");
+  qRegisterMetaType<MythPianoPlaylist>("MythPianoPlaylist");
+
+  QThread thread;
+  MythPianoWorker *worker = new MythPianoWorker(1);
+  MythPianoSession *session = worker->Session(0);
+  MythPianoBench bench(worker, rounds);
+
+  worker->moveToThread(&thread);
+  QObject::connect(&thread, SIGNAL(started()), worker, SLOT(Start()));
+  QObject::connect(session, SIGNAL(StationsChanged(MythPianoStringList)),
+		   &bench, SLOT(bench_stations(MythPianoStringList)), Qt::QueuedConnection);
+  QObject::connect(session, SIGNAL(Disconnected(QString)),
+		   &bench, SLOT(bench_disconnected(QString)), Qt::QueuedConnection);
+  session->SetServer(host, port);
+  thread.start();
+
+  char auth[512];
+  snprintf(auth, sizeof(auth), "user %s %s\n", user, password);
+  session->BeginLogin();
+  worker->Post(MythPianoCommand(MythPianoCommand::Login, 200, auth));
+
+  int ret = 0;
+  if(session->WaitForLogin(seconds * 1000) < 0) {
+	fprintf(stderr, "could not log in to pianod at %s port %d\n", host, port);
+	ret = 1;
+  } else {
+	/* the rounds start from bench_stations() once the login's list is in */
+	QTimer::singleShot(seconds * 1000, &app, SLOT(quit()));
+	app.exec();
+
+	double secs = bench.Seconds();
+	printf("%d rounds in %.2f s, %.1f rounds/s\n", bench.Rounds(), secs,
+	       secs > 0 ? bench.Rounds() / secs : 0.0);
+	if(bench.Rounds() < rounds)
+		ret = 1;
+  }
+
+  worker->Stop("Exiting mythpianobench");
+  if(!thread.wait(5000))
+	fprintf(stderr, "pianod thread did not exit\n");
+
+  QStringList report = GetMythPianoStats()->Report();
+  for(int x = 0; x < report.size(); x++)
+	printf("%s\n", report[x].toUtf8().data());
+
+  delete worker;
+  return ret;
+}
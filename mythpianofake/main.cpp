@@ -0,0 +1,555 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * mythpianofake: a pretend pianod, for exercising the plugin without a
+ * Pandora account or a network.
+ *
+ * It speaks enough of pianod's line protocol for everything the plugin
+ * does: log in, list stations, select and play one, status, queue,
+ * skip, pause, rate, volume. Tracks change on their own every few
+ * minutes, with the 104 and 101 notices pianod pushes to every client
+ * at once; clients ask for "status" to find out what is on.
+ *
+ * The point is making it misbehave on purpose:
+ *   -n stations    how many stations the account has (default 20)
+ *   -d ms          delay every line we send by this much
+ *   -j ms          plus up to this much more, at random
+ *   -x commands    hang up on a client after this many commands
+ *   -b notices     push this many playback notices in a burst...
+ *   -i ms          ...this often
+ *   -t seconds     track length (default 180)
+ *
+ * Or, with -r, it plays back a session recorded by the plugin itself
+ * (pandora-trace) instead; see replay.cpp.
+ *
+ * Point the plugin at it (pandora-host 127.0.0.1, pandora-port 4445),
+ * turn on pandora-stats-interval, and the log tells you what each user
+ * action costs under whatever conditions you set up here.
+ *
+ * usage: mythpianofake [-v] [-n stations] [-d ms] [-j ms] [-x commands]
+ *                      [-b notices -i ms] [-t seconds] [port]
+ *        mythpianofake [-v] -r trace [-s speed] [port]
+ */
+
+// POSIX headers
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+}
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+// MythPianod headers
+#include "mythpianofake.h"
+
+using namespace std;
+
+int debug = 0;
+
+long long now_ms()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+class Fake
+{
+ public:
+  Fake();
+
+  int  Listen(int port);
+  void Run();
+
+  int stations;
+  int delay;
+  int jitter;
+  int drop_after;
+  int burst;
+  int burst_interval;
+  int track_length;
+
+ private:
+  /* what we have said but the network has not delivered yet */
+  struct Line {
+    long long due;
+    string    text;
+  };
+  struct Client {
+    string       in;
+    string       out;
+    list<Line>   later;
+    long long    last_due;
+    int          commands;
+  };
+
+  void Accept();
+  void Read(int fd);
+  void Command(int fd, const string &line);
+  void Drop(int fd);
+  void Say(int fd, const string &text);
+  void Everyone(const string &text);
+  void Deliver(long long now);
+  int  Flush(int fd, Client &c);
+
+  void   NextTrack();
+  string Station(int n) const;
+  string Song(int track) const;
+  string Position() const;
+
+  int               listen_fd;
+  map<int, Client>  clients;
+
+  /* one player, shared by everyone, like pianod's */
+  int               state;      // 101 playing, 102 paused, 103 stopped
+  int               station;
+  int               track;
+  long long         track_start;
+  long long         paused_at;
+  long long         next_burst;
+};
+
+void nonblock(int fd)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+Fake::Fake()
+  : stations(20),
+    delay(0),
+    jitter(0),
+    drop_after(0),
+    burst(0),
+    burst_interval(0),
+    track_length(180),
+    listen_fd(-1),
+    state(103),
+    station(-1),
+    track(0),
+    track_start(0),
+    paused_at(0),
+    next_burst(0)
+{
+}
+
+/* Where pianod would be, loopback only: nothing here is for the outside. */
+int listen_on(int port)
+{
+  struct sockaddr_in addr;
+  int on = 1;
+  int fd;
+
+  if((fd = ::socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+	perror("socket");
+	return -1;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if(::bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+     ::listen(fd, 16) < 0) {
+	perror("could not listen");
+	close(fd);
+	return -1;
+  }
+
+  nonblock(fd);
+  return fd;
+}
+
+int Fake::Listen(int port)
+{
+  if((listen_fd = listen_on(port)) < 0)
+	return -1;
+
+  printf("Pretending to be pianod on 127.0.0.1 port %d.\n", port);
+  return 0;
+}
+
+string Fake::Station(int n) const
+{
+  char name[32];
+
+  snprintf(name, sizeof(name), "Station %d", n);
+  return name;
+}
+
+string Fake::Song(int t) const
+{
+  char block[512];
+
+  snprintf(block, sizeof(block),
+	   "203 Data\n"
+	   "111 ID: fake%d\n"
+	   "112 Album: Album %d\n"
+	   "113 Artist: Artist %d\n"
+	   "114 Title: Song %d\n"
+	   "115 Station: %s\n"
+	   "116 Rating: %s\n"
+	   "117 CoverArt: http://127.0.0.1/art/%d.jpg\n",
+	   t, t / 10, t % 7, t, Station(station < 0 ? 0 : station).c_str(),
+	   t % 3 == 0 ? "good" : "", t);
+  return block;
+}
+
+/* "101 00:10/03:00/-02:50 Playing" and friends */
+string Fake::Position() const
+{
+  static const char *names[] = { "Playing", "Paused", "Stopped", "Intertrack" };
+  long long at = state == 102 ? paused_at : now_ms();
+  int played = state == 103 ? 0 : (int) ((at - track_start) / 1000);
+  int left = track_length - played;
+  char line[96];
+
+  if(left < 0)
+	left = 0;
+  snprintf(line, sizeof(line), "%d %02d:%02d/%02d:%02d/-%02d:%02d %s\n",
+	   state, played / 60, played % 60, track_length / 60, track_length % 60,
+	   left / 60, left % 60, names[state - 101]);
+  return line;
+}
+
+/* Everyone hears about a new track; what it is, they have to ask. */
+void Fake::NextTrack()
+{
+  track++;
+  track_start = now_ms();
+  state = 101;
+  Everyone("104 00:00/00:00/-00:00 Intertrack\n");
+  Everyone(Position());
+}
+
+/* Queue 'text' as if it had crossed a slow network: late, but in order. */
+void Fake::Say(int fd, const string &text)
+{
+  map<int, Client>::iterator it = clients.find(fd);
+  if(it == clients.end())
+	return;
+
+  Client &c = it->second;
+  long long due = now_ms() + delay + (jitter ? rand() % (jitter + 1) : 0);
+
+  if(due < c.last_due)
+	due = c.last_due;
+  c.last_due = due;
+
+  Line line;
+  line.due = due;
+  line.text = text;
+  c.later.push_back(line);
+}
+
+void Fake::Everyone(const string &text)
+{
+  for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); it++)
+	Say(it->first, text);
+}
+
+void Fake::Accept()
+{
+  int fd;
+
+  while((fd = ::accept(listen_fd, NULL, NULL)) >= 0) {
+	nonblock(fd);
+	clients[fd].last_due = 0;
+	clients[fd].commands = 0;
+	Say(fd, "100 mythpianofake\n200 Success\n");
+	if(debug)
+	printf("client %d connected\n", fd);
+  }
+}
+
+void Fake::Drop(int fd)
+{
+  close(fd);
+  clients.erase(fd);
+  if(debug)
+  printf("client %d gone\n", fd);
+}
+
+void Fake::Read(int fd)
+{
+  char buf[4096];
+  int len = read(fd, buf, sizeof(buf));
+
+  if(len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+	Drop(fd);
+	return;
+  }
+  if(len < 0)
+	return;
+
+  clients[fd].in.append(buf, len);
+
+  size_t eol;
+  while(clients.count(fd) && (eol = clients[fd].in.find('\n')) != string::npos) {
+	string line = clients[fd].in.substr(0, eol);
+	clients[fd].in.erase(0, eol + 1);
+	if(!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+	if(!line.empty())
+		Command(fd, line);
+  }
+}
+
+void Fake::Command(int fd, const string &line)
+{
+  Client &c = clients[fd];
+
+  if(debug)
+  printf("client %d: %s\n", fd, line.c_str());
+
+  if(drop_after && ++c.commands > drop_after) {
+	printf("hanging up on client %d after %d commands\n", fd, drop_after);
+	/* what has arrived has arrived; anything still in flight is lost */
+	Deliver(now_ms());
+	Flush(fd, c);
+	Drop(fd);
+	return;
+  }
+
+  if(line.compare(0, 5, "user ") == 0) {
+	Say(fd, "200 Success\n");
+  } else if(line == "stations list" || line == "stations") {
+	string list = "203 Data\n";
+	for(int x = 0; x < stations; x++)
+		list += "115 Station: " + Station(x) + "\n";
+	Say(fd, list + "204 End of data\n");
+  } else if(line.compare(0, 15, "select station ") == 0) {
+	string name = line.substr(15);
+	if(name.size() >= 2 && name[0] == '"')
+		name = name.substr(1, name.size() - 2);
+	int found = -1;
+	for(int x = 0; x < stations && found < 0; x++)
+		if(Station(x) == name)
+			found = x;
+	if(found < 0) {
+		Say(fd, "404 No such station\n");
+	} else {
+		station = found;
+		Say(fd, "200 Success\n");
+	}
+  } else if(line == "play") {
+	Say(fd, "200 Success\n");
+	if(state == 103 && station >= 0)
+		NextTrack();
+	else if(state == 102) {
+		track_start += now_ms() - paused_at;
+		state = 101;
+		Everyone(Position());
+	}
+  } else if(line == "playpause" || line == "pause") {
+	Say(fd, "200 Success\n");
+	if(state == 101) {
+		paused_at = now_ms();
+		state = 102;
+		Everyone(Position());
+	} else if(state == 102) {
+		track_start += now_ms() - paused_at;
+		state = 101;
+		Everyone(Position());
+	}
+  } else if(line == "stop" || line == "stop now") {
+	Say(fd, "200 Success\n");
+	if(state != 103) {
+		state = 103;
+		Everyone("103 Stopped\n");
+	}
+  } else if(line == "skip") {
+	Say(fd, "200 Success\n");
+	if(state != 103)
+		NextTrack();
+  } else if(line == "status") {
+	if(state == 103)
+		Say(fd, "103 Stopped\n204 End of data\n");
+	else
+		Say(fd, Position() + Song(track) + "204 End of data\n");
+  } else if(line == "queue") {
+	Say(fd, Song(track + 1) + Song(track + 2) + "204 End of data\n");
+  } else if(line.compare(0, 5, "rate ") == 0 ||
+	    line.compare(0, 7, "volume ") == 0) {
+	Say(fd, "200 Success\n");
+  } else if(line == "quit") {
+	Say(fd, "200 Success\n");
+  } else {
+	Say(fd, "400 Bad command\n");
+  }
+}
+
+/* Move whatever the network would have delivered by now into the output. */
+void Fake::Deliver(long long now)
+{
+  for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); it++) {
+	Client &c = it->second;
+	while(!c.later.empty() && c.later.front().due <= now) {
+		c.out += c.later.front().text;
+		c.later.pop_front();
+	}
+  }
+}
+
+int Fake::Flush(int fd, Client &c)
+{
+  while(!c.out.empty()) {
+	int len = write(fd, c.out.data(), c.out.size());
+	if(len < 0 && errno == EINTR)
+		continue;
+	if(len < 0 && errno != EAGAIN)
+		return -1;
+	if(len <= 0)
+		return 0;
+	c.out.erase(0, len);
+  }
+  return 0;
+}
+
+void Fake::Run()
+{
+  if(burst && burst_interval)
+	next_burst = now_ms() + burst_interval;
+
+  for(;;) {
+	long long now = now_ms();
+	long long wake = now + 1000;
+	vector<struct pollfd> fds;
+	vector<int> dead;
+	struct pollfd pfd;
+
+	if(state == 101 && now - track_start >= track_length * 1000LL)
+		NextTrack();
+
+	if(next_burst && now >= next_burst) {
+		for(int x = 0; x < burst && state != 103; x++)
+			Everyone(Position());
+		next_burst = now + burst_interval;
+	}
+
+	Deliver(now);
+
+	pfd.fd = listen_fd;
+	pfd.events = POLLIN;
+	fds.push_back(pfd);
+
+	for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); it++) {
+		if(Flush(it->first, it->second) < 0) {
+			dead.push_back(it->first);
+			continue;
+		}
+		if(!it->second.later.empty() && it->second.later.front().due < wake)
+			wake = it->second.later.front().due;
+		pfd.fd = it->first;
+		pfd.events = POLLIN | (it->second.out.empty() ? 0 : POLLOUT);
+		fds.push_back(pfd);
+	}
+	for(size_t x = 0; x < dead.size(); x++)
+		Drop(dead[x]);
+
+	if(next_burst && next_burst < wake)
+		wake = next_burst;
+
+	int timeout = wake > now ? (int) (wake - now) : 0;
+	if(poll(&fds[0], fds.size(), timeout) < 0) {
+		if(errno == EINTR)
+			continue;
+		perror("poll");
+		return;
+	}
+
+	for(size_t x = 0; x < fds.size(); x++) {
+		if(!(fds[x].revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+		if(fds[x].fd == listen_fd)
+			Accept();
+		else if(clients.count(fds[x].fd))
+			Read(fds[x].fd);
+	}
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Fake fake;
+  int port = 4445;
+  const char *trace = NULL;
+  double speed = 1;
+  int opt;
+
+  while((opt = getopt(argc, argv, "vn:d:j:x:b:i:t:r:s:")) != -1) {
+	switch(opt) {
+	case 'v': debug = 1; break;
+	case 'n': fake.stations = atoi(optarg); break;
+	case 'd': fake.delay = atoi(optarg); break;
+	case 'j': fake.jitter = atoi(optarg); break;
+	case 'x': fake.drop_after = atoi(optarg); break;
+	case 'b': fake.burst = atoi(optarg); break;
+	case 'i': fake.burst_interval = atoi(optarg); break;
+	case 't': fake.track_length = atoi(optarg); break;
+	case 'r': trace = optarg; break;
+	case 's': speed = atof(optarg); break;
+	default:
+		fprintf(stderr, "usage: %s [-v] [-n stations] [-d ms] [-j ms] [-x commands]\n"
+			"       [-b notices -i ms] [-t seconds] [port]\n"
+			"       %s [-v] -r trace [-s speed] [port]\n", argv[0], argv[0]);
+		return 1;
+	}
+  }
+  if(optind < argc)
+	port = atoi(argv[optind++]);
+  if(fake.track_length <= 0)
+	fake.track_length = 180;
+
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  srand(time(NULL));
+
+  if(trace)
+	return Replay(trace, port, speed);
+
+  if(fake.Listen(port) < 0)
+	return 1;
+
+  fake.Run();
+  return 1;
+}
@@ -0,0 +1,17 @@
+include ( ../../mythconfig.mak )
+include ( ../../settings.pro )
+
+# A stand-in for pianod, for working on the plugin without a Pandora
+# account or a network, or to play back a recorded session. Not built
+# or installed with the rest; run qmake and make here when you want it.
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt moc
+TARGET = mythpianofake
+
+INCLUDEPATH += ../mythpianod
+
+# Input
+HEADERS += mythpianofake.h ../mythpianod/mythpianotrace.h
+SOURCES += main.cpp replay.cpp ../mythpianod/mythpianotrace.cpp
@@ -0,0 +1,393 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * parsebench: pianod output through MythPianoParser, checked and timed.
+ *
+ * The streams come from traces recorded with pandora-trace (what pianod
+ * sent, one stream per connection), from plain transcripts of pianod
+ * output, or, with no files given, from made-up welcome, stations list,
+ * status and queue replies of a large account.
+ *
+ * Every stream is
+ *   - fed in one piece and again in random chunks, down to a byte at a
+ *     time; both must give exactly the same events;
+ *   - mutated at random (flipped bytes, stray CRs, NULs and newlines,
+ *     cut and doubled runs, lines around the length limit) -n times and
+ *     fed both ways again, which must not crash and must still agree;
+ *   - fed in 4096 byte reads, as the session does, for -t seconds to
+ *     measure lines per second and allocations per line and per reply.
+ *
+ * usage: parsebench [-n rounds] [-s seed] [-t seconds] [file...]
+ *
+ * Exits 1 if a check fails; the seed it prints reproduces the failure.
+ */
+
+// POSIX headers
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <new>
+#include <string>
+#include <vector>
+
+// MythPianod headers
+#include "mythpianoparser.h"
+#include "mythpianotrace.h"
+
+using namespace std;
+
+/* every allocation the program makes, so the timed run can count the parser's */
+static unsigned long allocations = 0;
+
+#if __cplusplus >= 201103L
+#define NEW_THROWS
+#else
+#define NEW_THROWS throw(std::bad_alloc)
+#endif
+
+void *operator new(size_t size) NEW_THROWS
+{
+  void *p = malloc(size ? size : 1);
+
+  if(!p)
+	throw std::bad_alloc();
+  allocations++;
+  return p;
+}
+
+void operator delete(void *p) throw()
+{
+  free(p);
+}
+
+static long long now_usec()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+struct Seen
+{
+  int    type;
+  int    code;
+  string value;
+
+  bool operator==(const Seen &o) const
+  {
+	return type == o.type && code == o.code && value == o.value;
+  }
+};
+
+/* Keeps a copy of every event and checks what the parser promises about it. */
+class Recorder : public MythPianoParserListener
+{
+ public:
+  Recorder() : broken(0) {}
+
+  void ParsedEvent(const MythPianoEvent &event)
+  {
+	Seen seen;
+
+	if(event.type < MythPianoEvent::Welcome || event.type > MythPianoEvent::Malformed ||
+	   event.length < 0 || event.length > 4096 || (event.length && !event.value) ||
+	   (event.length && memchr(event.value, '\n', event.length)) ||
+	   (event.type != MythPianoEvent::Malformed && (event.code < 0 || event.code > 999))) {
+		broken++;
+		return;
+	}
+
+	seen.type = event.type;
+	seen.code = event.code;
+	seen.value.assign(event.value, event.length);
+	events.push_back(seen);
+  }
+
+  vector<Seen> events;
+  int          broken;
+};
+
+/* Just counts, so the timed run measures the parser and not us. */
+class Counter : public MythPianoParserListener
+{
+ public:
+  Counter() : lines(0), replies(0) {}
+
+  void ParsedEvent(const MythPianoEvent &event)
+  {
+	lines++;
+	if(event.type == MythPianoEvent::Success || event.type == MythPianoEvent::DataEnd ||
+	   event.type == MythPianoEvent::Error)
+		replies++;
+  }
+
+  unsigned long lines;
+  unsigned long replies;
+};
+
+/*
+ * Feed the stream in one piece (max_chunk 0) or in random pieces of one
+ * to max_chunk bytes. Returns what Feed() last returned.
+ */
+static int FeedAll(const string &s, MythPianoParserListener *listener,
+		   unsigned *seed, int max_chunk)
+{
+  MythPianoParser parser(listener);
+  size_t at = 0;
+
+  while(at < s.size()) {
+	size_t n = max_chunk ? 1 + rand_r(seed) % max_chunk : s.size();
+
+	if(n > s.size() - at)
+		n = s.size() - at;
+	if(parser.Feed(s.data() + at, n) < 0)
+		return -1;
+	at += n;
+  }
+  return 0;
+}
+
+/* Split and unsplit must agree, line for line and on where a too-long line stops it. */
+static bool Agree(const string &s, unsigned split, int max_chunk, const char *what, unsigned seed)
+{
+  Recorder whole, pieces;
+  int rw = FeedAll(s, &whole, NULL, 0);
+  int rp = FeedAll(s, &pieces, &split, max_chunk);
+
+  if(whole.broken || pieces.broken) {
+	fprintf(stderr, "%s: bad event from the parser (seed %u)\n", what, seed);
+	return false;
+  }
+  if(rw != rp || whole.events.size() != pieces.events.size()) {
+	fprintf(stderr, "%s: %d events (%d) in one piece, %d (%d) in pieces of up to %d (seed %u)\n",
+		what, (int) whole.events.size(), rw, (int) pieces.events.size(), rp, max_chunk, seed);
+	return false;
+  }
+  for(size_t x = 0; x < whole.events.size(); x++) {
+	if(!(whole.events[x] == pieces.events[x])) {
+		fprintf(stderr, "%s: event %d differs in pieces of up to %d (seed %u)\n",
+			what, (int) x, max_chunk, seed);
+		return false;
+	}
+  }
+  return true;
+}
+
+static string Mutate(const string &in, unsigned *seed)
+{
+  string s = in;
+  int n = 1 + rand_r(seed) % 8;
+
+  for(int x = 0; x < n; x++) {
+	size_t at = s.empty() ? 0 : rand_r(seed) % s.size();
+
+	switch(rand_r(seed) % 7) {
+	case 0:
+		if(!s.empty())
+			s[at] = (char) rand_r(seed);
+		break;
+	case 1:
+		s.insert(at, 1, '\n');
+		break;
+	case 2:
+		s.insert(at, 1, '\r');
+		break;
+	case 3:
+		s.insert(at, 1, '\0');
+		break;
+	case 4:
+		s.erase(at, 1 + rand_r(seed) % 64);
+		break;
+	case 5:
+		s.insert(at, s.substr(at, rand_r(seed) % 256));
+		break;
+	case 6:
+		/* somewhere either side of the 4096 byte line limit */
+		s.insert(at, string(4000 + rand_r(seed) % 200, 'x'));
+		break;
+	}
+  }
+  return s;
+}
+
+static string Song(int t)
+{
+  char block[512];
+
+  snprintf(block, sizeof(block),
+	   "203 Data\n"
+	   "111 ID: bench%d\n"
+	   "112 Album: Album %d\n"
+	   "113 Artist: Artist %d\n"
+	   "114 Title: Song %d\n"
+	   "115 Station: Station %d\n"
+	   "116 Rating: %s\n"
+	   "117 CoverArt: http://127.0.0.1/art/%d.jpg\n",
+	   t, t / 10, t % 7, t, t % 20, t % 3 == 0 ? "good" : "", t);
+  return block;
+}
+
+/* What pianod says to a client that logs in, lists stations, asks for status and queue. */
+static string Synthetic()
+{
+  string s = "100 pianod\n200 Success\n200 Success\n";
+  char line[64];
+
+  s += "203 Data\n";
+  for(int x = 0; x < 2000; x++) {
+	snprintf(line, sizeof(line), "115 Station: Station %d\n", x);
+	s += line;
+  }
+  s += "204 End of data\n";
+
+  s += "101 00:10/03:00/-02:50 Playing\n" + Song(1) + "204 End of data\n";
+  s += "104 00:00/00:00/-00:00 Intertrack\n101 00:00/03:00/-03:00 Playing\n";
+  for(int x = 2; x < 52; x++)
+	s += Song(x);
+  s += "204 End of data\n";
+  return s;
+}
+
+/* A trace gives one stream per connection, of what pianod sent; anything else is taken as is. */
+static int Load(const char *path, vector<string> *streams)
+{
+  FILE *f = fopen(path, "rb");
+  char header[8];
+
+  if(!f) {
+	perror(path);
+	return -1;
+  }
+  size_t n = fread(header, 1, sizeof(header), f);
+
+  /* the magic MythPianoTraceWriter starts its files with */
+  if(n == sizeof(header) && !memcmp(header, "MPTRACE1", sizeof(header))) {
+	MythPianoTraceReader reader;
+	MythPianoTraceRecord record;
+
+	fclose(f);
+	if(reader.Open(path) < 0)
+		return -1;
+	while(reader.Next(&record)) {
+		if(record.type == MythPianoTraceRecord::Connected || streams->empty())
+			streams->push_back(string());
+		if(record.type == MythPianoTraceRecord::Read)
+			streams->back() += record.data;
+	}
+	return 0;
+  }
+
+  string s(header, n);
+  char buf[65536];
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	s.append(buf, n);
+  fclose(f);
+  streams->push_back(s);
+  return 0;
+}
+
+static void Bench(const vector<string> &streams, double seconds)
+{
+  Counter counter;
+  MythPianoParser parser(&counter);
+  unsigned long long bytes = 0;
+  long long start = now_usec(), elapsed;
+  unsigned long before = allocations;
+
+  do {
+	for(size_t x = 0; x < streams.size(); x++) {
+		const string &s = streams[x];
+
+		parser.Reset();
+		for(size_t at = 0; at < s.size(); at += 4096)
+			parser.Feed(s.data() + at, s.size() - at < 4096 ? s.size() - at : 4096);
+		bytes += s.size();
+	}
+  } while((elapsed = now_usec() - start) < seconds * 1000000);
+
+  unsigned long allocs = allocations - before;
+  double secs = elapsed / 1e6;
+
+  printf("%lu lines, %lu replies in %.2f s: %.0f lines/s, %.1f MB/s\n",
+	 counter.lines, counter.replies, secs, counter.lines / secs, bytes / secs / 1e6);
+  printf("%lu allocations: %.4f per line, %.4f per reply\n", allocs,
+	 counter.lines ? (double) allocs / counter.lines : 0.0,
+	 counter.replies ? (double) allocs / counter.replies : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+  vector<string> streams;
+  unsigned seed = time(NULL) ^ getpid();
+  int rounds = 2000;
+  double seconds = 2;
+  int failed = 0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "n:s:t:")) != -1) {
+	switch(opt) {
+	case 'n': rounds = atoi(optarg); break;
+	case 's': seed = strtoul(optarg, NULL, 10); break;
+	case 't': seconds = atof(optarg); break;
+	default:
+		fprintf(stderr, "usage: %s [-n rounds] [-s seed] [-t seconds] [file...]\n", argv[0]);
+		return 1;
+	}
+  }
+
+  for(int x = optind; x < argc; x++)
+	if(Load(argv[x], &streams) < 0)
+		return 1;
+  if(streams.empty())
+	streams.push_back(Synthetic());
+
+  printf("%d streams, seed %u\n", (int) streams.size(), seed);
+
+  static const int chunks[] = { 1, 2, 3, 7, 64, 4096 };
+  unsigned split = seed;
+  for(size_t x = 0; x < streams.size(); x++)
+	for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+		if(!Agree(streams[x], rand_r(&split), chunks[c], "as recorded", seed))
+			failed++;
+
+  for(int r = 0; r < rounds; r++) {
+	unsigned round = seed + r;
+	string s = Mutate(streams[rand_r(&round) % streams.size()], &round);
+	int max_chunk = rand_r(&round) % 3 ? 1 + rand_r(&round) % 64 : 4096;
+
+	if(!Agree(s, rand_r(&round), max_chunk, "mutated", seed + r))
+		failed++;
+  }
+  printf("%d of %d checks failed\n", failed,
+	 (int) (streams.size() * (sizeof(chunks) / sizeof(chunks[0]))) + rounds);
+
+  Bench(streams, seconds);
+  return failed ? 1 : 0;
+}
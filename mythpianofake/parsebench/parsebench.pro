@@ -0,0 +1,17 @@
+include ( ../../../mythconfig.mak )
+include ( ../../../settings.pro )
+
+# Throughput and fuzz checks for MythPianoParser, which needs nothing but
+# the C++ library. Not built or installed with the rest; run qmake and
+# make here, then ./parsebench [trace or transcript files].
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt moc
+TARGET = parsebench
+
+INCLUDEPATH += ../../mythpianod
+
+# Input
+HEADERS += ../../mythpianod/mythpianoparser.h ../../mythpianod/mythpianotrace.h
+SOURCES += main.cpp ../../mythpianod/mythpianoparser.cpp ../../mythpianod/mythpianotrace.cpp
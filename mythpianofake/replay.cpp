@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * Play back a pianod session the plugin recorded (pandora-trace) to
+ * whatever connects, so the same timing can be put in front of the
+ * plugin again and again.
+ *
+ * Each connection in the trace is served to one client, in order. What
+ * pianod said goes out with the gaps it had, divided by 'speed' (0: no
+ * gaps at all), but never before the client has sent what the plugin
+ * had sent by then: a reply waits for its request however fast or slow
+ * the client is today. Where the client says something other than what
+ * was recorded, that is reported and the replay carries on. If pianod
+ * hung up in the recording we hang up too; otherwise we wait for the
+ * client to.
+ */
+
+// POSIX headers
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+#include <sys/socket.h>
+}
+
+#include <string>
+#include <vector>
+
+// MythPianod headers
+#include "mythpianotrace.h"
+#include "mythpianofake.h"
+
+using namespace std;
+
+struct Segment {
+  string                       server;
+  vector<MythPianoTraceRecord> records;
+};
+
+static long long now_us()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Cut the trace up at each Connected. */
+static int Load(const char *path, vector<Segment> *segments)
+{
+  MythPianoTraceReader reader;
+  MythPianoTraceRecord record;
+
+  if(reader.Open(path) < 0)
+	return -1;
+
+  while(reader.Next(&record)) {
+	if(record.type == MythPianoTraceRecord::Connected) {
+		segments->push_back(Segment());
+		segments->back().server = record.data;
+	}
+	if(!segments->empty())
+		segments->back().records.push_back(record);
+  }
+
+  if(segments->empty()) {
+	fprintf(stderr, "%s has no connections in it\n", path);
+	return -1;
+  }
+  return 0;
+}
+
+static int Wait(int listen_fd)
+{
+  struct pollfd pfd;
+  int fd;
+
+  pfd.fd = listen_fd;
+  pfd.events = POLLIN;
+  for(;;) {
+	if((fd = ::accept(listen_fd, NULL, NULL)) >= 0) {
+		nonblock(fd);
+		return fd;
+	}
+	if(errno != EAGAIN && errno != EINTR) {
+		perror("accept");
+		return -1;
+	}
+	poll(&pfd, 1, -1);
+  }
+}
+
+/* One recorded connection, start to end, to the client on 'fd'. */
+static void Serve(int fd, const Segment &seg, int number, double speed)
+{
+  const vector<MythPianoTraceRecord> &records = seg.records;
+  string expected;    // everything the plugin wrote, back to back
+  string out;
+  string partial;     // a line from the client we have not seen the end of
+  size_t next = 0;
+  size_t received = 0, needed = 0;
+  int diverged = 0;
+  long long started = now_us();
+  long long finished = 0;
+  uint64_t anchor_trace = records[0].usec;
+  long long anchor_real = started;
+  /* did pianod hang up on the plugin, or the other way round? */
+  int lost = records.back().type == MythPianoTraceRecord::Disconnected;
+
+  for(size_t x = 0; x < records.size(); x++)
+	if(records[x].type == MythPianoTraceRecord::Wrote)
+		expected += records[x].data;
+
+  printf("connection %d (was %s): %d records\n", number, seg.server.c_str(),
+	 (int) records.size());
+
+  for(;;) {
+	long long now = now_us();
+	long long wake = -1;
+
+	while(next < records.size()) {
+		const MythPianoTraceRecord &rec = records[next];
+
+		if(rec.type == MythPianoTraceRecord::Wrote) {
+			if(received < needed + rec.data.size())
+				break;
+			needed += rec.data.size();
+		} else if(rec.type == MythPianoTraceRecord::Read) {
+			long long due = anchor_real;
+			if(speed > 0)
+				due += (long long) ((rec.usec - anchor_trace) / speed);
+			if(now < due) {
+				wake = due;
+				break;
+			}
+			out += rec.data;
+		} else if(rec.type == MythPianoTraceRecord::Disconnected && debug) {
+			printf("connection %d: pianod hung up: %s\n", number, rec.data.c_str());
+		}
+		/* the next gap is measured from here */
+		anchor_trace = rec.usec;
+		anchor_real = now;
+		next++;
+	}
+
+	while(!out.empty()) {
+		int len = write(fd, out.data(), out.size());
+		if(len < 0 && errno == EINTR)
+			continue;
+		if(len <= 0)
+			break;
+		out.erase(0, len);
+	}
+
+	if(next == records.size() && out.empty()) {
+		if(!finished)
+			finished = now_us();
+		if(lost)
+			break;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN | (out.empty() ? 0 : POLLOUT);
+	int timeout = wake < 0 ? -1 : (int) ((wake - now + 999) / 1000);
+	if(poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+		perror("poll");
+		break;
+	}
+	if(!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+		continue;
+
+	char buf[4096];
+	int len = read(fd, buf, sizeof(buf));
+	if(len < 0 && (errno == EAGAIN || errno == EINTR))
+		continue;
+	if(len <= 0) {
+		if(next < records.size())
+			printf("connection %d: client hung up %d records short of the end\n",
+			       number, (int) (records.size() - next));
+		break;
+	}
+
+	/* the trace has the login without its credentials; so must what we compare */
+	partial.append(buf, len);
+	size_t eol = partial.rfind('\n');
+	if(eol == string::npos)
+		continue;
+	string got = MythPianoTraceRedact(partial.data(), eol + 1);
+	partial.erase(0, eol + 1);
+
+	for(size_t x = 0; x < got.size() && !diverged; x++) {
+		if(received + x >= expected.size() || expected[received + x] != got[x]) {
+			printf("connection %d: client strays from the trace at byte %d\n",
+			       number, (int) (received + x));
+			diverged = 1;
+		}
+	}
+	received += got.size();
+  }
+
+  close(fd);
+  printf("connection %d: recorded %.3fs, played back in %.3fs\n", number,
+	 (records.back().usec - records.front().usec) / 1e6,
+	 ((finished ? finished : now_us()) - started) / 1e6);
+}
+
+int Replay(const char *path, int port, double speed)
+{
+  vector<Segment> segments;
+  int listen_fd;
+
+  if(Load(path, &segments) < 0 || (listen_fd = listen_on(port)) < 0)
+	return 1;
+
+  printf("Replaying %d connections from %s on 127.0.0.1 port %d at %gx.\n",
+	 (int) segments.size(), path, port, speed);
+
+  for(size_t x = 0; x < segments.size(); x++) {
+	int fd = Wait(listen_fd);
+	if(fd < 0)
+		return 1;
+	Serve(fd, segments[x], x + 1, speed);
+  }
+
+  close(listen_fd);
+  return 0;
+}
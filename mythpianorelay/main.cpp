@@ -0,0 +1,753 @@
+/*
+Copyright (c) 2012
+Michael R. Hines <michael@hinespot.com>
+Modified from: Doug Turner < dougt@dougt.org >
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * mythpianorelay: share one pianod connection between many frontends.
+ *
+ * Every frontend running the plugin would otherwise hold its own pianod
+ * connection. Run this next to them (pandora-relay set to its socket)
+ * and they talk to it over a Unix socket instead; it holds the single
+ * connection to pianod, forwards each frontend's commands, routes every
+ * reply back to whoever asked, and fans out what pianod pushes on its
+ * own (playback notices, new tracks) to all of them.
+ *
+ * While pianod is unreachable the relay turns frontends away with a
+ * "400 pianod unavailable" in place of its greeting, so they fall back
+ * to connecting to pianod themselves. Getting back to pianod never holds
+ * up the frontends already here: the name is looked up on a thread of
+ * its own and the connect is a non-blocking one, each with a deadline.
+ *
+ * usage: mythpianorelay [-d] [-s socket] [host [port]]
+ */
+
+// POSIX headers
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <netdb.h>
+}
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+// MythPianod headers
+#include "mythpianoparser.h"
+
+using namespace std;
+
+static int debug = 0;
+
+/* a frontend that can't keep up with this much output is dropped */
+static size_t max_backlog = 1 << 20;
+/* how long to wait before trying pianod again, in seconds */
+static int retry_interval = 5;
+/* how long looking pianod up, or connecting to one of its addresses, may take */
+static int connect_timeout = 10;
+
+static const char *greeting = "100 mythpianorelay\n200 Success\n";
+static const char *unavailable = "400 pianod unavailable\n";
+
+class Relay : public MythPianoParserListener
+{
+ public:
+  /* what a reply can hold besides its last line */
+  enum Data { NoData, Songs, Listing };
+
+  Relay(const char *path, const char *host, const char *port);
+  ~Relay();
+
+  int  Listen();
+  void Run();
+
+  void ParsedEvent(const MythPianoEvent &event);
+
+ private:
+  struct Client {
+    string in;
+    string out;
+  };
+
+  struct Owner {
+    int fd;     /* -1: nobody */
+    int data;
+  };
+
+  /* where the 203 block at hand goes */
+  enum Block { NoBlock, Ours, Pushed, Undecided };
+
+  void Connect();
+  void Resolved();
+  void Dial();
+  void Dialed();
+  void Connected(int fd);
+  void ConnectFailed(const char *why);
+  void Disconnect(const char *why);
+  void Accept();
+  void ReadClient(int fd);
+  void ReadPianod();
+  void Drop(int fd);
+  void Send(int fd, const string &line);
+  void Everyone(const string &line);
+  void Reply(const string &line, int last);
+  void Flush(int fd, string &out);
+
+  string            path;
+  string            host;
+  string            port;
+  int               listen_fd;
+  int               pianod_fd;
+  /* getting to pianod: the lookup's pipe, then the connect in progress */
+  int               resolve_fd;
+  struct addrinfo  *addrs;
+  struct addrinfo  *next_addr;
+  int               dial_fd;
+  long long         deadline;
+  long long         retry_at;
+  string            pianod_out;
+  MythPianoParser   parser;
+  map<int, Client>  clients;
+  /* who each outstanding pianod reply goes to, oldest first */
+  list<Owner>       owners;
+  int               block;
+  string            held;
+};
+
+/* The commands whose replies come with 203 blocks; the rest only ever answer 2xx or 4xx. */
+static int ReplyData(const string &command)
+{
+  string word = command.substr(0, command.find_first_of(" \r\n"));
+
+  if(word == "stations")
+	return Relay::Listing;
+  if(word == "status" || word == "queue" || word == "history")
+	return Relay::Songs;
+  return Relay::NoData;
+}
+
+static void nonblock(int fd)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static long long now_ms()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* A name lookup on its own thread; the answer comes back down a pipe. */
+struct Lookup {
+  string host;
+  string port;
+  int    fd;
+};
+
+struct Answer {
+  int              err;
+  struct addrinfo *res;
+};
+
+static void *Resolve(void *arg)
+{
+  Lookup *lookup = (Lookup *) arg;
+  struct addrinfo hints;
+  Answer answer;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  answer.res = NULL;
+  answer.err = getaddrinfo(lookup->host.c_str(), lookup->port.c_str(), &hints, &answer.res);
+
+  /* nobody reading any more: the relay gave up on us */
+  if(write(lookup->fd, &answer, sizeof(answer)) != (ssize_t) sizeof(answer) && answer.res)
+	freeaddrinfo(answer.res);
+  close(lookup->fd);
+  delete lookup;
+  return NULL;
+}
+
+Relay::Relay(const char *p, const char *h, const char *pt)
+  : path(p),
+    host(h),
+    port(pt),
+    listen_fd(-1),
+    pianod_fd(-1),
+    resolve_fd(-1),
+    addrs(NULL),
+    next_addr(NULL),
+    dial_fd(-1),
+    deadline(0),
+    retry_at(0),
+    parser(this),
+    block(NoBlock)
+{
+}
+
+Relay::~Relay()
+{
+  if(resolve_fd != -1)
+	close(resolve_fd);
+  if(dial_fd != -1)
+	close(dial_fd);
+  if(addrs)
+	freeaddrinfo(addrs);
+  if(listen_fd != -1) {
+	close(listen_fd);
+	unlink(path.c_str());
+  }
+}
+
+int Relay::Listen()
+{
+  struct sockaddr_un addr;
+
+  if(path.size() >= sizeof(addr.sun_path)) {
+	fprintf(stderr, "socket path too long: %s\n", path.c_str());
+	return -1;
+  }
+
+  if((listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	perror("could not open relay socket");
+	return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+
+  if(::bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+     ::listen(listen_fd, 16) < 0) {
+	perror("could not listen on relay socket");
+	return -1;
+  }
+
+  nonblock(listen_fd);
+  return 0;
+}
+
+/* Start looking pianod up; Resolved() takes it from there. */
+void Relay::Connect()
+{
+  pthread_t thread;
+  pthread_attr_t attr;
+  int fds[2];
+
+  if(pipe(fds) < 0) {
+	perror("could not look up pianod server");
+	retry_at = now_ms() + retry_interval * 1000;
+	return;
+  }
+
+  Lookup *lookup = new Lookup;
+  lookup->host = host;
+  lookup->port = port;
+  lookup->fd = fds[1];
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int err = pthread_create(&thread, &attr, Resolve, lookup);
+  pthread_attr_destroy(&attr);
+
+  if(err) {
+	fprintf(stderr, "could not look up pianod server: %s\n", strerror(err));
+	close(fds[0]);
+	close(fds[1]);
+	delete lookup;
+	retry_at = now_ms() + retry_interval * 1000;
+	return;
+  }
+
+  nonblock(fds[0]);
+  resolve_fd = fds[0];
+  deadline = now_ms() + connect_timeout * 1000;
+}
+
+void Relay::Resolved()
+{
+  Answer answer;
+  int len = read(resolve_fd, &answer, sizeof(answer));
+
+  if(len < 0 && (errno == EAGAIN || errno == EINTR))
+	return;
+
+  close(resolve_fd);
+  resolve_fd = -1;
+
+  if(len != (int) sizeof(answer)) {
+	ConnectFailed("could not look up pianod server");
+	return;
+  }
+  if(answer.err) {
+	fprintf(stderr, "could not resolve pianod server %s: %s\n",
+		host.c_str(), gai_strerror(answer.err));
+	ConnectFailed(NULL);
+	return;
+  }
+
+  addrs = next_addr = answer.res;
+  Dial();
+}
+
+/* Try the addresses from next_addr on until one connects or is in progress. */
+void Relay::Dial()
+{
+  for(; next_addr; next_addr = next_addr->ai_next) {
+	int fd = ::socket(next_addr->ai_family, next_addr->ai_socktype, next_addr->ai_protocol);
+	if(fd < 0)
+		continue;
+	nonblock(fd);
+	if(::connect(fd, next_addr->ai_addr, next_addr->ai_addrlen) == 0) {
+		Connected(fd);
+		return;
+	}
+	if(errno == EINPROGRESS) {
+		dial_fd = fd;
+		deadline = now_ms() + connect_timeout * 1000;
+		return;
+	}
+	close(fd);
+  }
+
+  ConnectFailed(NULL);
+}
+
+/* The connect in progress is done, one way or the other. */
+void Relay::Dialed()
+{
+  int err = 0;
+  socklen_t len = sizeof(err);
+  int fd = dial_fd;
+
+  dial_fd = -1;
+  if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+	err = errno;
+  if(!err) {
+	Connected(fd);
+	return;
+  }
+
+  close(fd);
+  next_addr = next_addr->ai_next;
+  Dial();
+}
+
+void Relay::Connected(int fd)
+{
+  freeaddrinfo(addrs);
+  addrs = next_addr = NULL;
+  pianod_fd = fd;
+
+  printf("Connected to pianod at %s port %s.\n", host.c_str(), port.c_str());
+  parser.Reset();
+  pianod_out.clear();
+  owners.clear();
+  block = NoBlock;
+  held.clear();
+  /* pianod's own greeting is for us, not for any frontend */
+  Owner us = { -1, NoData };
+  owners.push_back(us);
+}
+
+/* Out of addresses or out of time; try again in a while. */
+void Relay::ConnectFailed(const char *why)
+{
+  if(why)
+	fprintf(stderr, "%s\n", why);
+  fprintf(stderr, "could not connect to pianod server %s port %s\n",
+	  host.c_str(), port.c_str());
+
+  if(addrs)
+	freeaddrinfo(addrs);
+  addrs = next_addr = NULL;
+  retry_at = now_ms() + retry_interval * 1000;
+}
+
+/* Lost pianod: every frontend goes too and will find its own way. */
+void Relay::Disconnect(const char *why)
+{
+  printf("%s\n", why);
+
+  close(pianod_fd);
+  pianod_fd = -1;
+  parser.Reset();
+  owners.clear();
+  block = NoBlock;
+  held.clear();
+
+  while(!clients.empty())
+	Drop(clients.begin()->first);
+}
+
+void Relay::Accept()
+{
+  int fd;
+
+  while((fd = ::accept(listen_fd, NULL, NULL)) >= 0) {
+	if(pianod_fd == -1) {
+		/* in place of the greeting; the plugin goes to pianod itself */
+		if(write(fd, unavailable, strlen(unavailable)) < 0 && debug)
+			perror("could not turn frontend away");
+		close(fd);
+		continue;
+	}
+	nonblock(fd);
+	clients[fd].out = greeting;
+	if(debug)
+	printf("frontend %d connected, %d total\n", fd, (int) clients.size());
+  }
+}
+
+void Relay::Drop(int fd)
+{
+  close(fd);
+  clients.erase(fd);
+
+  /* replies still on their way to it have nowhere to go */
+  for(list<Owner>::iterator it = owners.begin(); it != owners.end(); it++)
+	if(it->fd == fd)
+		it->fd = -1;
+
+  if(debug)
+  printf("frontend %d gone, %d left\n", fd, (int) clients.size());
+}
+
+/* Each command line from a frontend goes to pianod; its reply comes back. */
+void Relay::ReadClient(int fd)
+{
+  Client &c = clients[fd];
+  char buf[4096];
+  int len = read(fd, buf, sizeof(buf));
+
+  if(len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+	Drop(fd);
+	return;
+  }
+  if(len < 0)
+	return;
+
+  c.in.append(buf, len);
+
+  size_t eol;
+  while((eol = c.in.find('\n')) != string::npos) {
+	if(eol > 0) {
+		Owner owner = { fd, ReplyData(c.in.substr(0, eol)) };
+		pianod_out.append(c.in, 0, eol + 1);
+		owners.push_back(owner);
+	}
+	c.in.erase(0, eol + 1);
+  }
+
+  if(c.in.size() > 4096)
+	Drop(fd);
+}
+
+void Relay::ReadPianod()
+{
+  char buf[8192];
+  int len = read(pianod_fd, buf, sizeof(buf));
+
+  if(len == 0)
+	Disconnect("pianod hung up");
+  else if(len < 0 && errno != EAGAIN && errno != EINTR)
+	Disconnect("Error getting response from pianod");
+  else if(len > 0 && parser.Feed(buf, len) < 0)
+	Disconnect("Line from pianod is too long");
+}
+
+/*
+ * Playback notices go to everyone. Anything else belongs to the oldest
+ * outstanding reply, which ends at a success, error or end of data
+ * line, the same terminators the plugin itself waits for. With nothing
+ * outstanding it is something pianod pushed, and goes to everyone.
+ *
+ * pianod also pushes track blocks, 203 ... 204, while a reply is owed,
+ * and their 204 must not end it. A command that answers with a single
+ * line can't be getting a 203, so such a block goes to everyone. For a
+ * station listing a block is held until it shows itself: station names
+ * only and it is the listing's, any other field and it is a track.
+ * For status and queue, which answer with track blocks themselves, there
+ * is no telling, and blocks are taken as the reply.
+ */
+void Relay::ParsedEvent(const MythPianoEvent &event)
+{
+  char code[8];
+  string line;
+  int last = event.type == MythPianoEvent::Success ||
+	     event.type == MythPianoEvent::Error ||
+	     event.type == MythPianoEvent::DataEnd;
+
+  if(event.type == MythPianoEvent::Malformed) {
+	line.assign(event.value, event.length);
+  } else {
+	snprintf(code, sizeof(code), "%03d", event.code);
+	line = code;
+	if(event.length)
+		line.append(" ").append(event.value, event.length);
+  }
+  line += '\n';
+
+  if(event.type == MythPianoEvent::Welcome)
+	return;
+
+  if(event.type == MythPianoEvent::Playback) {
+	Everyone(line);
+	return;
+  }
+
+  if(event.type == MythPianoEvent::DataStart) {
+	/* another block after a held one: that one was all station names */
+	if(block == Undecided)
+		Reply(held, 0);
+	held.clear();
+
+	if(owners.empty() || owners.front().data == NoData)
+		block = Pushed;
+	else if(owners.front().data == Listing)
+		block = Undecided;
+	else
+		block = Ours;
+  }
+
+  switch(block) {
+  case Pushed:
+	/* an error is never pushed; it is the answer to the command */
+	if(event.type != MythPianoEvent::Error) {
+		Everyone(line);
+		if(last)
+			block = NoBlock;
+		return;
+	}
+	break;
+
+  case Undecided:
+	if(event.type == MythPianoEvent::Field && event.code != 115) {
+		Everyone(held);
+		Everyone(line);
+		held.clear();
+		block = Pushed;
+		return;
+	}
+	if(!last) {
+		held += line;
+		return;
+	}
+	line = held + line;
+	held.clear();
+	break;
+  }
+
+  if(last)
+	block = NoBlock;
+
+  if(owners.empty())
+	Everyone(line);
+  else
+	Reply(line, last);
+}
+
+/* To the oldest outstanding reply's frontend; its last line retires it. */
+void Relay::Reply(const string &line, int last)
+{
+  if(owners.empty())
+	return;
+
+  if(owners.front().fd != -1)
+	Send(owners.front().fd, line);
+  if(last)
+	owners.pop_front();
+}
+
+void Relay::Everyone(const string &line)
+{
+  vector<int> all;
+
+  for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); it++)
+	all.push_back(it->first);
+  for(size_t x = 0; x < all.size(); x++)
+	Send(all[x], line);
+}
+
+void Relay::Send(int fd, const string &line)
+{
+  map<int, Client>::iterator it = clients.find(fd);
+
+  if(it == clients.end())
+	return;
+
+  it->second.out += line;
+  if(it->second.out.size() > max_backlog) {
+	fprintf(stderr, "frontend %d is not keeping up, dropping it\n", fd);
+	Drop(fd);
+  }
+}
+
+/* Write as much of out as the socket takes; returns with the rest. */
+void Relay::Flush(int fd, string &out)
+{
+  while(!out.empty()) {
+	int len = write(fd, out.data(), out.size());
+	if(len < 0 && errno == EINTR)
+		continue;
+	if(len <= 0)
+		return;
+	out.erase(0, len);
+  }
+}
+
+void Relay::Run()
+{
+  for(;;) {
+	vector<struct pollfd> fds;
+	struct pollfd pfd;
+	long long now = now_ms();
+	int timeout = -1;
+
+	/* a lookup or connect that has had its time */
+	if(now >= deadline) {
+		if(resolve_fd != -1) {
+			close(resolve_fd);
+			resolve_fd = -1;
+			ConnectFailed("pianod server lookup timed out");
+		} else if(dial_fd != -1) {
+			close(dial_fd);
+			dial_fd = -1;
+			next_addr = next_addr->ai_next;
+			Dial();
+		}
+	}
+
+	int getting = resolve_fd != -1 || dial_fd != -1;
+	if(pianod_fd == -1 && !getting && now >= retry_at) {
+		Connect();
+		getting = resolve_fd != -1;
+	}
+
+	pfd.fd = listen_fd;
+	pfd.events = POLLIN;
+	fds.push_back(pfd);
+
+	if(pianod_fd != -1) {
+		Flush(pianod_fd, pianod_out);
+		pfd.fd = pianod_fd;
+		pfd.events = POLLIN | (pianod_out.empty() ? 0 : POLLOUT);
+		fds.push_back(pfd);
+	} else if(resolve_fd != -1) {
+		pfd.fd = resolve_fd;
+		pfd.events = POLLIN;
+		fds.push_back(pfd);
+	} else if(dial_fd != -1) {
+		pfd.fd = dial_fd;
+		pfd.events = POLLOUT;
+		fds.push_back(pfd);
+	}
+
+	for(map<int, Client>::iterator it = clients.begin(); it != clients.end(); it++) {
+		Flush(it->first, it->second.out);
+		pfd.fd = it->first;
+		pfd.events = POLLIN | (it->second.out.empty() ? 0 : POLLOUT);
+		fds.push_back(pfd);
+	}
+
+	if(pianod_fd == -1) {
+		long long until = (getting ? deadline : retry_at) - now_ms();
+		timeout = until < 0 ? 0 : (int) until;
+	}
+
+	if(poll(&fds[0], fds.size(), timeout) < 0) {
+		if(errno == EINTR)
+			continue;
+		perror("poll");
+		return;
+	}
+
+	for(size_t x = 0; x < fds.size(); x++) {
+		if(!fds[x].revents)
+			continue;
+		if(fds[x].fd == resolve_fd)
+			Resolved();
+		else if(fds[x].fd == dial_fd)
+			Dialed();
+		else if(!(fds[x].revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+		else if(fds[x].fd == listen_fd)
+			Accept();
+		else if(fds[x].fd == pianod_fd)
+			ReadPianod();
+		else if(clients.count(fds[x].fd))
+			ReadClient(fds[x].fd);
+	}
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = "/tmp/mythpianorelay.sock";
+  const char *host = "127.0.0.1";
+  const char *port = "4445";
+  int opt;
+
+  while((opt = getopt(argc, argv, "ds:")) != -1) {
+	switch(opt) {
+	case 'd': debug = 1; break;
+	case 's': path = optarg; break;
+	default:
+		fprintf(stderr, "usage: %s [-d] [-s socket] [host [port]]\n", argv[0]);
+		return 1;
+	}
+  }
+  if(optind < argc)
+	host = argv[optind++];
+  if(optind < argc)
+	port = argv[optind++];
+
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  Relay relay(path, host, port);
+  if(relay.Listen() < 0)
+	return 1;
+
+  relay.Run();
+  return 1;
+}
@@ -0,0 +1,19 @@
+include ( ../../mythconfig.mak )
+include ( ../../settings.pro )
+
+PREFIX=/usr/local
+
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt moc
+TARGET = mythpianorelay
+target.path = $${PREFIX}/bin
+INSTALLS += target
+
+INCLUDEPATH += ../mythpianod
+
+# Input
+HEADERS += ../mythpianod/mythpianoparser.h
+SOURCES += main.cpp ../mythpianod/mythpianoparser.cpp
+
+LIBS += -lpthread